@@ -0,0 +1,420 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "array.hpp"
+#include "tree.hpp"
+
+// binary tree whose nodes live side by side in one buffer and link to
+// each other with 32-bit indices. a node costs sizeof(T) + 8 bytes
+// instead of sizeof(T) + 16 plus the allocator's header, the whole tree
+// is freed with one call and cloned with one copy of the buffer
+constexpr uint32_t arena_null = UINT32_MAX;
+
+template <typename T>
+struct arena_node {
+    T value{};
+    uint32_t left{arena_null};
+    uint32_t right{arena_null};
+};
+
+template <typename T, typename Growth = geometric_growth<>>
+class arena_tree {
+    array<arena_node<T>> nodes;
+    uint32_t length{0};
+    uint32_t root{arena_null};
+
+    static constexpr bool relocatable = is_trivially_relocatable_v<arena_node<T>>;
+
+    public:
+    using value_type = T;
+    using node_type = arena_node<T>;
+
+    static constexpr uint32_t null = arena_null;
+
+    arena_tree(uint32_t capacity = 16): nodes(capacity) {}
+
+    // converts a pointer tree, nodes are stored in preorder
+    explicit arena_tree(tree_node<T> *source): nodes(16) {
+        struct pending {
+            tree_node<T> *node;
+            uint32_t parent;
+            bool right;
+        };
+
+        std::vector<pending> stack;
+        stack.push_back(pending{source, null, false});
+
+        while (!stack.empty()) {
+            pending next = stack.back();
+            stack.pop_back();
+            if (next.node == nullptr) {
+                continue;
+            }
+
+            uint32_t idx = add(next.node->value);
+            if (next.parent == null) {
+                root = idx;
+            } else if (next.right) {
+                data()[next.parent].right = idx;
+            } else {
+                data()[next.parent].left = idx;
+            }
+            stack.push_back(pending{next.node->right, idx, true});
+            stack.push_back(pending{next.node->left, idx, false});
+        }
+    }
+
+    arena_tree(arena_tree&& rhs) noexcept: nodes(std::move(rhs.nodes)), length(rhs.length), root(rhs.root) {
+        rhs.length = 0;
+        rhs.root = null;
+    }
+
+    arena_tree& operator = (arena_tree&& rhs) noexcept {
+        destroy_values();
+        nodes = std::move(rhs.nodes);
+        length = rhs.length;
+        root = rhs.root;
+        rhs.length = 0;
+        rhs.root = null;
+        return *this;
+    }
+
+    arena_tree(const arena_tree&) = delete;
+    arena_tree& operator = (const arena_tree&) = delete;
+
+    // one free for the whole tree; values are only visited when they
+    // have a destructor to run
+    ~arena_tree() {
+        destroy_values();
+    }
+
+    uint32_t size() const {
+        return length;
+    }
+
+    bool empty() const {
+        return length == 0;
+    }
+
+    uint32_t capacity() const {
+        return nodes.size();
+    }
+
+    uint32_t get_root() const {
+        return root;
+    }
+
+    void set_root(uint32_t idx) {
+        assert(idx == null || idx < length);
+        root = idx;
+    }
+
+    node_type& operator [] (uint32_t idx) {
+        assert(idx < length);
+        return data()[idx];
+    }
+
+    const node_type& operator [] (uint32_t idx) const {
+        assert(idx < length);
+        return data()[idx];
+    }
+
+    node_type* data() {
+        return nodes.data();
+    }
+
+    const node_type* data() const {
+        return nodes.data();
+    }
+
+    // appends a node and returns its index, children must already exist
+    uint32_t add(T value, uint32_t left = null, uint32_t right = null) {
+        assert(left == null || left < length);
+        assert(right == null || right < length);
+
+        if (length == nodes.size()) {
+            resize(Growth::grow(nodes.size(), length + 1));
+        }
+        nodes.construct(length, node_type{std::move(value), left, right});
+        return length++;
+    }
+
+    void reserve(uint32_t capacity) {
+        if (capacity > nodes.size()) {
+            resize(capacity);
+        }
+    }
+
+    // drops every node but keeps the buffer for reuse
+    void clear() {
+        destroy_values();
+        length = 0;
+        root = null;
+    }
+
+    // bytewise copy of the buffer when the nodes allow it
+    arena_tree clone() const {
+        arena_tree copy(std::max(1U, length));
+        if constexpr (std::is_trivially_copyable_v<node_type>) {
+            std::memcpy(static_cast<void *>(copy.data()), data(), sizeof(node_type) * length);
+        } else {
+            for (uint32_t i = 0; i != length; ++i) {
+                copy.nodes.construct(i, data()[i]);
+            }
+        }
+        copy.length = length;
+        copy.root = root;
+        return copy;
+    }
+
+    // every node in storage order, the fastest walk when order does not matter
+    template <typename Visitor>
+    void for_each(Visitor&& func) {
+        for (uint32_t i = 0; i != length; ++i) {
+            func(data()[i]);
+        }
+    }
+
+    private:
+    void destroy_values() {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (uint32_t i = 0; i != length; ++i) {
+                nodes.destroy(i);
+            }
+        }
+    }
+
+    void resize(uint32_t new_size) {
+        if constexpr (relocatable) {
+            nodes.reallocate(new_size);
+        } else {
+            array<node_type> new_nodes(new_size);
+            for (uint32_t i = 0; i != length; ++i) {
+                new_nodes.construct(i, std::move(nodes[i]));
+                nodes.destroy(i);
+            }
+            nodes = std::move(new_nodes);
+        }
+    }
+};
+
+template <typename Tree>
+struct is_arena_tree : std::false_type {};
+
+template <typename T, typename Growth>
+struct is_arena_tree<arena_tree<T, Growth>> : std::true_type {};
+
+template <typename Tree>
+constexpr bool is_arena_tree_v = is_arena_tree<std::remove_const_t<Tree>>::value;
+
+template <typename Visitor, typename Node>
+inline bool visit_arena(Visitor& func, Node& node) {
+    if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, Node&>, bool>) {
+        return func(node);
+    } else {
+        func(node);
+        return true;
+    }
+}
+
+// the traversals of tree.hpp over an arena_tree. visitors take the node
+// by reference; the same bool early termination applies
+
+template <typename Tree, typename Visitor>
+static bool arena_recursive_preorder(Tree& tree, uint32_t idx, Visitor& func) {
+    if (idx != arena_null) {
+        auto& node = tree[idx];
+        return visit_arena(func, node)
+            && arena_recursive_preorder(tree, node.left, func)
+            && arena_recursive_preorder(tree, node.right, func);
+    }
+    return true;
+}
+
+template <typename Tree, typename Visitor>
+static bool arena_recursive_inorder(Tree& tree, uint32_t idx, Visitor& func) {
+    if (idx != arena_null) {
+        auto& node = tree[idx];
+        return arena_recursive_inorder(tree, node.left, func)
+            && visit_arena(func, node)
+            && arena_recursive_inorder(tree, node.right, func);
+    }
+    return true;
+}
+
+template <typename Tree, typename Visitor>
+static bool arena_recursive_postorder(Tree& tree, uint32_t idx, Visitor& func) {
+    if (idx != arena_null) {
+        auto& node = tree[idx];
+        return arena_recursive_postorder(tree, node.left, func)
+            && arena_recursive_postorder(tree, node.right, func)
+            && visit_arena(func, node);
+    }
+    return true;
+}
+
+// (root, left, right)
+template <typename Tree, typename Visitor>
+static std::enable_if_t<is_arena_tree_v<Tree>, bool> recursive_preorder(Tree& tree, Visitor&& func) {
+    return arena_recursive_preorder(tree, tree.get_root(), func);
+}
+
+// (left, root, right)
+template <typename Tree, typename Visitor>
+static std::enable_if_t<is_arena_tree_v<Tree>, bool> recursive_inorder(Tree& tree, Visitor&& func) {
+    return arena_recursive_inorder(tree, tree.get_root(), func);
+}
+
+// (left, right, root)
+template <typename Tree, typename Visitor>
+static std::enable_if_t<is_arena_tree_v<Tree>, bool> recursive_postorder(Tree& tree, Visitor&& func) {
+    return arena_recursive_postorder(tree, tree.get_root(), func);
+}
+
+// the iterative versions keep 4-byte indices on a vector, so a
+// degenerate tree of any depth is fine
+
+// (root, left, right)
+template <typename Tree, typename Visitor>
+static std::enable_if_t<is_arena_tree_v<Tree>, bool> iterative_preorder(Tree& tree, Visitor&& func) {
+    std::vector<uint32_t> stack;
+    stack.push_back(tree.get_root());
+
+    while (!stack.empty()) {
+        uint32_t idx = stack.back();
+        stack.pop_back();
+
+        if (idx != arena_null) {
+            auto& node = tree[idx];
+            if (!visit_arena(func, node)) {
+                return false;
+            }
+            stack.push_back(node.right);
+            stack.push_back(node.left);
+        }
+    }
+    return true;
+}
+
+// (left, root, right)
+template <typename Tree, typename Visitor>
+static std::enable_if_t<is_arena_tree_v<Tree>, bool> iterative_inorder(Tree& tree, Visitor&& func) {
+    std::vector<uint32_t> stack;
+    uint32_t idx = tree.get_root();
+
+    while (idx != arena_null || !stack.empty()) {
+        if (idx != arena_null) {
+            // follow left child to the leaf
+            stack.push_back(idx);
+            idx = tree[idx].left;
+        } else {
+            auto& node = tree[stack.back()];
+            stack.pop_back();
+            if (!visit_arena(func, node)) {
+                return false;
+            }
+            idx = node.right;
+        }
+    }
+    return true;
+}
+
+// (left, root, right) with a visited bit per node instead of the pointer
+// version's hash set: indices are dense, so a bitmap of size() bits does
+template <typename Tree, typename Visitor>
+static std::enable_if_t<is_arena_tree_v<Tree>, bool> iterative_inorder_with_marking(Tree& tree, Visitor&& func) {
+    std::vector<uint32_t> stack;
+    std::vector<bool> visited(tree.size());
+    stack.push_back(tree.get_root());
+
+    while (!stack.empty()) {
+        uint32_t idx = stack.back();
+
+        if (idx == arena_null) {
+            stack.pop_back();
+            continue;
+        }
+
+        auto& node = tree[idx];
+        if (node.left != arena_null && !visited[node.left]) {
+            stack.push_back(node.left);
+        } else {
+            stack.pop_back();
+            if (!visit_arena(func, node)) {
+                return false;
+            }
+            visited[idx] = true;
+            stack.push_back(node.right);
+        }
+    }
+    return true;
+}
+
+// (left, root, right) without a stack: the walk threads temporary right
+// links through the buffer, so the tree must not be const and must not be
+// read by anyone else meanwhile. the links are undone even after an early stop
+template <typename Tree, typename Visitor>
+static std::enable_if_t<is_arena_tree_v<Tree>, bool> morris_inorder(Tree& tree, Visitor&& func) {
+    static_assert(!std::is_const_v<Tree>, "morris_inorder rewrites links while it walks");
+
+    uint32_t curr = tree.get_root();
+    bool visiting = true;
+
+    while (curr != arena_null) {
+        auto& node = tree[curr];
+        if (node.left == arena_null) {
+            visiting = visiting && visit_arena(func, node);
+            curr = node.right;
+            continue;
+        }
+
+        uint32_t prev = node.left;
+        while (tree[prev].right != arena_null && tree[prev].right != curr) {
+            prev = tree[prev].right;
+        }
+
+        if (tree[prev].right == arena_null) {
+            tree[prev].right = curr;
+            curr = node.left;
+        } else {
+            tree[prev].right = arena_null;
+            visiting = visiting && visit_arena(func, node);
+            curr = node.right;
+        }
+    }
+    return visiting;
+}
+
+// (left, right, root)
+template <typename Tree, typename Visitor>
+static std::enable_if_t<is_arena_tree_v<Tree>, bool> iterative_postorder(Tree& tree, Visitor&& func) {
+    std::vector<uint32_t> stack;
+    uint32_t idx = tree.get_root();
+    uint32_t last = arena_null;
+
+    while (idx != arena_null || !stack.empty()) {
+        if (idx != arena_null) {
+            stack.push_back(idx);
+            idx = tree[idx].left;
+        } else {
+            auto& node = tree[stack.back()];
+            // go right once, visit when coming back from the right
+            if (node.right != arena_null && node.right != last) {
+                idx = node.right;
+            } else {
+                if (!visit_arena(func, node)) {
+                    return false;
+                }
+                last = stack.back();
+                stack.pop_back();
+            }
+        }
+    }
+    return true;
+}
@@ -2,392 +2,980 @@
 #include <cassert>
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
+#include "array.hpp"
+#include "mapped_array.hpp"
 #include "stat.hpp"
+#include "static_array.hpp"
 
-template <typename T>
-class array {
-    T *storage{nullptr};
-    uint32_t length;
-    public:
-    array(uint32_t length): length(length) {
-        assert(length != 0);
-        storage = new T[length];
-    }
+struct pod {
+    size_t value;
+};
 
-    ~array() {
-        delete [] storage;
+template <typename Array>
+void test_add(Array& stack, size_t count) {
+    using T = typename Array::value_type;
+    for (size_t i = 0; i < count; ++i) {
+        stack.add(i, T{i});
     }
 
-    T& operator [] (size_t idx) {
-        return storage[idx];
+    assert(stack.size() == count);
+    for (size_t i = 0; i < count; ++i) {
+        assert(stack.get(i).value == i);
     }
+    std::cout << "test_add > " << stack.get(0) << std::endl;
+}
 
-    uint32_t size() const {
-        return length;
-    }
+template <typename Array>
+void test_set(Array& stack) {
+    using T = typename Array::value_type;
+    stack.get(0) = T(23);
+    stack.get(stack.size() - 1) = T(32);
+
+    assert(stack.get(0).value == 23);
+    assert(stack.get(stack.size() - 1).value == 32);
+
+    std::cout << "test_set > " << stack.get(0) << std::endl;
+}
 
-    array(array&& rhs) noexcept {
-        *this = rhs;
+template <typename Array>
+void test_remove(Array& stack) {
+    auto size = stack.size();
+    stack.remove(0);
+    stack.remove(stack.size()-1);
+
+    assert(stack.size() == size - 2);
+
+    for (size_t i = 0; i < stack.size(); ++i) {
+        assert(stack.get(i).value == i + 1);
     }
 
-    array& operator = (array&& rhs) noexcept {
-        if (storage != nullptr) {
-            delete [] storage;
-        }
+    std::cout << "test_remove > " << stack.get(0) << std::endl;
+}
 
-        storage = rhs.storage;
-        length = rhs.length;
-        rhs.storage = nullptr;
-        rhs.length = 0;
-        return *this;
+void test_vector(size_t count) {
+    std::vector<cnt<1>> stack;
+    for (size_t i = 0; i < count; ++i) {
+        stack.push_back(cnt<1>());
     }
 
-    array(const array&) = delete;
-    array& operator = (const array&) = delete;
-};
+    std::cout << "test_vector > " << stack[0] << std::endl;
+}
 
-template <typename T>
-class ArrayStack {
-    protected:
-    array<T> _array;
-    uint32_t length{0};
+void test_array_stack() {
+    std::cout << "ArrayStack test" << std::endl;
+    ArrayStack<cnt<0>> stack(4);
 
-    public:
-    ArrayStack(): _array(4) {
-    }
+    test_add(stack, 6);
+    test_vector(6);
+    test_set(stack);
+    test_remove(stack);
+}
 
-    ArrayStack(uint32_t capacity): _array(capacity) {
-    }
+void test_fast_array_stack() {
+    std::cout << "FastArrayStack test" << std::endl;
+    FastArrayStack<cnt<2>> stack(4);
 
-    virtual ~ArrayStack() {}
+    test_add(stack, 6);
+    test_vector(6);
+    test_set(stack);
+    test_remove(stack);
+}
 
-    uint32_t size() const {
-        return length;
+template <typename Queue>
+void test_queue_add(Queue& queue, size_t count) {
+    using T = typename Queue::value_type;
+    for (size_t i = 0; i < count; ++i) {
+        queue.add(T{i});
     }
 
-    T& get(size_t idx) {
-        return _array[idx];
+    assert(queue.size() == count);
+    for (size_t i = 0; i < count; ++i) {
+        assert(queue.get(i).value == i);
     }
+    std::cout << "test_queue_add > " << queue.get(0) << std::endl;
+}
+
+template <typename Queue>
+void test_queue_remove(Queue& queue, size_t count) {
+    using T = typename Queue::value_type;
+    assert(queue.size() == count);
 
-    T set(size_t idx, const T& val) {
-        T tmp = std::move(_array[idx]);
-        _array[idx] = val;
-        return tmp;
+    for (size_t i = 0; i < count; ++i) {
+        assert(queue.remove().value == i);
     }
 
-    T set(size_t idx, T&& val) noexcept {
-        T tmp = std::move(_array[idx]);
-        _array[idx] = std::move(val);
-        return tmp;
+    assert(queue.size() == 0);
+
+    std::cout << "test_queue_remove > " << T() << std::endl;
+}
+
+template <typename Queue>
+void test_queue_positional_add_remove(Queue& queue) {
+    using T = typename Queue::value_type;
+    assert(queue.size() == 0);
+
+    queue.add(0, T{0});
+    queue.add(1, T{1});
+    queue.add(2, T{2});
+
+    queue.add(0, T{3});
+    queue.add(1, T{4});
+
+    assert(queue.get(0).value == 3);
+    assert(queue.get(1).value == 4);
+    assert(queue.get(2).value == 0);
+    assert(queue.get(3).value == 1);
+    assert(queue.get(4).value == 2);
+
+    assert(queue.remove(2).value == 0);
+    assert(queue.remove(3).value == 2);
+    assert(queue.remove(2).value == 1);
+    assert(queue.remove(0).value == 3);
+    assert(queue.remove(0).value == 4);
+
+    assert(queue.size() == 0);
+
+    std::cout << "test_queue_positional_add_remove > " << T() << std::endl;
+}
+
+void test_queue() {
+    std::cout << "ArrayQueue test" << std::endl;
+    ArrayQueue<cnt<3>> queue(4);
+
+    test_queue_add(queue, 6);
+    test_queue_remove(queue, 6);
+    test_queue_positional_add_remove(queue);
+}
+
+void test_power_of_two_queue() {
+    std::cout << "power of two ArrayQueue test" << std::endl;
+    assert(round_up_pow2(0) == 1 && round_up_pow2(1) == 1 && round_up_pow2(5) == 8 && round_up_pow2(64) == 64);
+    assert(round_up_pow2((1U << 31) - 1) == (1U << 31) && round_up_pow2(1U << 31) == (1U << 31));
+
+    ArrayQueue<cnt<9>, true> queue(5);
+    assert(queue.capacity() == 8);
+
+    test_queue_add(queue, 6);
+    test_queue_remove(queue, 6);
+    test_queue_positional_add_remove(queue);
+
+    for (size_t i = 0; i < 100; ++i) {
+        queue.add(cnt<9>{i});
+        assert((queue.capacity() & (queue.capacity() - 1)) == 0);
+    }
+    for (size_t i = 0; i < 100; ++i) {
+        assert(queue.remove().value == i);
     }
+}
 
-    void add(size_t idx, T val) {
-        if (length + 1 > _array.size()) {
-            resize();
+template <typename Queue>
+void test_queue_bulk(Queue& queue) {
+    using T = typename Queue::value_type;
+    std::vector<T> in;
+    std::vector<T> out(1000);
+    size_t next = 0;
+    size_t expected = 0;
+
+    // uneven batches keep the ring wrapped around its end
+    for (size_t round = 0; round < 50; ++round) {
+        in.clear();
+        for (size_t i = 0; i < 37; ++i) {
+            in.push_back(T{next++});
         }
+        queue.add_n(in.begin(), in.size());
 
-        for (size_t i = length; i > idx; --i) {
-            _array[i] = std::move(_array[i - 1]);
+        size_t removed = queue.remove_n(out.begin(), 29);
+        assert(removed == 29);
+        for (size_t i = 0; i < removed; ++i) {
+            assert(out[i].value == expected++);
         }
+    }
 
-        _array[idx] = std::move(val);
-        ++length;
+    size_t rest = queue.size();
+    assert(queue.remove_n(out.begin(), out.size()) == rest);
+    for (size_t i = 0; i < rest; ++i) {
+        assert(out[i].value == expected++);
     }
+    assert(queue.empty());
+    assert(expected == next);
+}
 
-    T remove(size_t idx) {
-        T tmp = std::move(_array[idx]);
+void test_bulk_queue() {
+    std::cout << "ArrayQueue bulk test" << std::endl;
+    {
+        ArrayQueue<pod> queue;
+        test_queue_bulk(queue);
+    }
+    {
+        ArrayQueue<cnt<10>, true> queue;
+        test_queue_bulk(queue);
+        std::cout << "test_bulk_queue > " << cnt<10>{} << std::endl;
+    }
+    assert(cnt<10>::copied == 0 && cnt<10>::copy_assigned == 0);
+}
 
-        for (size_t i = idx; i < length - 1; ++i) {
-            _array[i] = std::move(_array[i + 1]);
+// both ends against std::deque, the spans always cover the queue in order
+template <typename Queue>
+void test_queue_double_ended(Queue& queue) {
+    using T = typename Queue::value_type;
+    std::deque<size_t> model;
+    uint64_t rng = 7;
+    auto next = [&rng] { rng = rng * 6364136223846793005ULL + 1442695040888963407ULL; return size_t(rng >> 33); };
+
+    for (size_t i = 0; i != 5000; ++i) {
+        switch (next() % (i < 2500 ? 5 : 6)) {
+            case 0:
+            case 1:
+                queue.add_front(T{i});
+                model.push_front(i);
+                break;
+            case 2:
+                queue.add(T{i});
+                model.push_back(i);
+                break;
+            case 3:
+            case 4:
+            case 5:
+                if (!model.empty()) {
+                    bool back = next() % 2;
+                    size_t expected = back ? model.back() : model.front();
+                    assert((back ? queue.remove_back() : queue.remove()).value == expected);
+                    back ? model.pop_back() : model.pop_front();
+                }
+                break;
         }
 
-        --length;
-
-        if (_array.size() >= 3 * length) {
-            resize();
+        auto [first, second] = queue.spans();
+        assert(first.size + second.size == model.size());
+        assert(first.size == 0 || first.data == &queue.get(0));
+        assert(second.size == 0 || second.data == &queue.get(first.size));
+        auto it = model.begin();
+        for (auto *run : {&first, &second}) {
+            for (auto& value : *run) {
+                assert(value.value == *it++);
+            }
         }
+    }
 
-        return tmp;
+    // drop a prefix the way a partial writev would
+    size_t written = queue.size() / 3;
+    queue.discard(written);
+    model.erase(model.begin(), model.begin() + written);
+    for (size_t i = 0; i != model.size(); ++i) {
+        assert(queue.get(i).value == model[i]);
     }
+}
 
-    protected:
-    virtual void resize() {
-        uint32_t new_size = std::max(4U, length + length / 2);
-        array<T> new_array(new_size);
-        for (size_t i = 0; i < length; ++i) {
-            new_array[i] = std::move(_array[i]);
-        }
+void test_double_ended_queue() {
+    std::cout << "double ended ArrayQueue test" << std::endl;
+    {
+        ArrayQueue<cnt<15>> queue;
+        test_queue_double_ended(queue);
+        ArrayQueue<cnt<15>, true, 8> small;
+        test_queue_double_ended(small);
+    }
+    assert(cnt<15>::constructed + cnt<15>::moved + cnt<15>::copied == cnt<15>::destroyed);
 
-        _array = std::move(new_array);
+    // a wrapped ring copied out with two memcpy calls
+    ArrayQueue<uint32_t, true> queue(8);
+    for (uint32_t i = 0; i != 6; ++i) {
+        queue.add(i);
     }
-};
+    queue.discard(4);
+    for (uint32_t i = 6; i != 10; ++i) {
+        queue.add(i);
+    }
+    queue.add_front(3U);
+    auto [first, second] = queue.spans();
+    assert(first.size != 0 && second.size != 0);
+
+    uint32_t out[7];
+    std::memcpy(out, first.data, first.size * sizeof(uint32_t));
+    std::memcpy(out + first.size, second.data, second.size * sizeof(uint32_t));
+    for (uint32_t i = 0; i != 7; ++i) {
+        assert(out[i] == 3 + i);
+    }
+    assert(queue.remove_back() == 9 && queue.size() == 6);
 
-template <typename T>
-class FastArrayStack : public ArrayStack<T> {
-    public:
-    FastArrayStack() {}
+    std::cout << "test_double_ended_queue > spans: " << first.size << " + " << second.size << std::endl;
+}
 
-    FastArrayStack(uint32_t capacity): ArrayStack<T>(capacity) {}
+// spare capacity must stay raw storage: only added elements are constructed
+// and every constructed or moved-into object is destroyed exactly once
+void test_raw_storage() {
+    std::cout << "raw storage test" << std::endl;
+    {
+        ArrayStack<cnt<4>> stack(64);
+        assert(cnt<4>::constructed == 0);
 
-    protected:
-    void resize() override {
-        uint32_t new_size = std::max(4U, this->length + this->length / 2);
-        array<T> new_array(new_size);
-        std::copy(&this->_array[0], &this->_array[this->length], &new_array[0]);
-        // for (size_t i = 0; i < length; ++i) {
-        //     new_array[i] = std::move(_array[i]);
-        // }
+        for (size_t i = 0; i < 100; ++i) {
+            stack.add(i, cnt<4>{i});
+        }
+        stack.add(50, cnt<4>{100});
+        stack.remove(10);
 
-        this->_array = std::move(new_array);
+        assert(cnt<4>::constructed == 101);
+        assert(cnt<4>::copied == 0 && cnt<4>::copy_assigned == 0);
+        std::cout << "test_raw_storage stack > " << stack.get(0) << std::endl;
     }
-};
+    assert(cnt<4>::constructed + cnt<4>::moved == cnt<4>::destroyed);
 
-template <typename T>
-class ArrayQueue {
-    array<T> _array;
-    size_t start_idx{0};
-    uint32_t length{0};
-    public:
+    {
+        ArrayQueue<cnt<5>> queue(64);
+        assert(cnt<5>::constructed == 0);
 
-    ArrayQueue(): _array(4) {}
-    ArrayQueue(uint32_t capacity) : _array(capacity) {}
-
-    template <typename U>
-    void add(U&& val) {
-        if (length + 1 > _array.size()) {
-            resize();
+        for (size_t i = 0; i < 100; ++i) {
+            queue.add(cnt<5>{i});
+        }
+        for (size_t i = 0; i < 30; ++i) {
+            assert(queue.remove().value == i);
         }
+        queue.add(5, cnt<5>{100});
+        queue.add(60, cnt<5>{101});
 
-        _array[ (start_idx + length) % _array.size() ] = std::move(val);
-        ++length;
+        assert(cnt<5>::constructed == 102);
+        assert(cnt<5>::copied == 0 && cnt<5>::copy_assigned == 0);
+        std::cout << "test_raw_storage queue > " << queue.get(0) << std::endl;
     }
+    assert(cnt<5>::constructed + cnt<5>::moved == cnt<5>::destroyed);
+}
 
-    template <typename U>
-    void add(size_t i, U&& val) {
-        assert(i <= length);
+// cnt<7> owns nothing but its vtable pointer, so it can be relocated bytewise
+template <>
+struct is_trivially_relocatable<cnt<7>> : std::true_type {};
 
-        if (length + 1 > _array.size()) {
-            resize();
+void test_relocation() {
+    std::cout << "FastArrayStack relocation test" << std::endl;
+    {
+        FastArrayStack<pod> stack;
+        for (size_t i = 0; i < 1000; ++i) {
+            stack.add(stack.size(), pod{i});
+        }
+        stack.add(0, pod{1000});
+        stack.add(500, pod{1001});
+        assert(stack.get(0).value == 1000);
+        assert(stack.get(1).value == 0);
+        assert(stack.get(500).value == 1001);
+        assert(stack.get(501).value == 499);
+
+        assert(stack.remove(500).value == 1001);
+        assert(stack.remove(0).value == 1000);
+        for (size_t i = 0; i < 1000; ++i) {
+            assert(stack.get(i).value == i);
+        }
+        while (stack.size() != 0) {
+            stack.remove(stack.size() - 1);
         }
+        std::cout << "test_relocation pod > ok" << std::endl;
+    }
 
-        if (i < length / 2) {
-            // move elements to the left
-            start_idx = (start_idx == 0 ? _array.size() - 1 : start_idx - 1);
-            for (size_t idx = 0; idx < i; ++idx) {
-                _array[ (start_idx + idx) % _array.size() ] = std::move(_array[ (start_idx + idx + 1) % _array.size() ]);
-            }
-        } else {
-            // move elements to the right
-            for (size_t idx = length; idx > i; --idx) {
-                _array[ (start_idx + idx) % _array.size() ] = std::move(_array[ (start_idx + idx - 1) % _array.size() ]);
-            }
+    {
+        // non-trivial type takes the move path
+        FastArrayStack<cnt<6>> stack;
+        test_add(stack, 100);
+        assert(cnt<6>::copied == 0 && cnt<6>::copy_assigned == 0);
+    }
+
+    {
+        // opted-in type is relocated bytewise: growth and shifting do not move
+        FastArrayStack<cnt<7>> stack;
+        for (size_t i = 0; i < 100; ++i) {
+            stack.add(0, cnt<7>{99 - i});
         }
+        // one move per add, from the by-value parameter into its slot
+        assert(cnt<7>::moved == 100);
+        test_remove(stack);
+        assert(cnt<7>::copied == 0 && cnt<7>::copy_assigned == 0);
+        assert(cnt<7>::move_assigned == 0);
+        assert(cnt<7>::moved <= 100 + 2 * 2);
+    }
+    assert(cnt<7>::constructed + cnt<7>::moved == cnt<7>::destroyed);
+}
 
-        _array[ (start_idx + i) % _array.size() ] = std::move(val);
-        ++length;
+// alternating add/remove must not reallocate on every call
+template <typename Array>
+void test_no_thrash(Array& stack, size_t count) {
+    using T = typename Array::value_type;
+    for (size_t i = 0; i < count; ++i) {
+        stack.add(stack.size(), T{i});
     }
 
-    T& get(size_t idx) {
-        return _array[ (start_idx + idx) % _array.size() ];
+    size_t reallocations = 0;
+    auto capacity = stack.capacity();
+    for (size_t i = 0; i < 1000; ++i) {
+        stack.remove(stack.size() - 1);
+        reallocations += (stack.capacity() != capacity);
+        capacity = stack.capacity();
+        stack.add(stack.size(), T{i});
+        reallocations += (stack.capacity() != capacity);
+        capacity = stack.capacity();
     }
 
-    bool empty() const {
-        return length == 0;
+    assert(reallocations <= 1);
+}
+
+// grows by a fixed step, never gives memory back
+struct linear_growth {
+    static uint32_t grow(uint32_t capacity, uint32_t required) {
+        return std::max(required, capacity + 16);
     }
 
-    auto size() const {
-        return length;
+    static uint32_t shrink(uint32_t capacity, uint32_t) {
+        return capacity;
     }
+};
 
-    T remove() {
-        assert(length != 0);
+void test_growth_policy() {
+    std::cout << "growth policy test" << std::endl;
 
-        T ret(std::move(_array[start_idx]));
+    for (size_t count = 1; count < 40; ++count) {
+        ArrayStack<pod> stack;
+        test_no_thrash(stack, count);
+        FastArrayStack<pod> fast;
+        test_no_thrash(fast, count);
+    }
 
-        start_idx = (start_idx + 1) % _array.size();
-        --length;
+    {
+        ArrayStack<pod, geometric_growth<2, 1, 4>> stack(1);
+        for (size_t i = 0; i < 100; ++i) {
+            stack.add(i, pod{i});
+        }
+        assert(stack.capacity() == 128);
+        while (stack.size() > 20) {
+            stack.remove(stack.size() - 1);
+        }
+        assert(stack.capacity() == 64);
+    }
 
-        if (_array.size() > 3 * length) {
-            resize();
+    {
+        ArrayStack<cnt<8>, never_shrink<>> stack;
+        test_add(stack, 100);
+        auto capacity = stack.capacity();
+        while (stack.size() != 0) {
+            stack.remove(0);
         }
+        assert(stack.capacity() == capacity);
 
-        return ret;
+        stack.shrink_to_fit();
+        assert(stack.capacity() == 1);
     }
 
-    T remove(size_t i) {
-        assert(i < length);
+    {
+        FastArrayStack<pod, linear_growth> stack;
+        stack.reserve(1000);
+        assert(stack.capacity() == 1000);
+        for (size_t i = 0; i < 1001; ++i) {
+            stack.add(i, pod{i});
+        }
+        assert(stack.capacity() == 1016);
+        stack.shrink_to_fit();
+        assert(stack.capacity() == 1001);
+        for (size_t i = 0; i < 1001; ++i) {
+            assert(stack.get(i).value == i);
+        }
+    }
 
-        T ret(std::move(_array[i]));
+    std::cout << "test_growth_policy > ok" << std::endl;
+}
 
-        if (i < length / 2) {
-            for (size_t idx = i, count = 0; count < i; --idx, ++count) {
-                _array[ (start_idx + idx) % _array.size() ] = std::move(_array[ (start_idx + idx - 1) % _array.size() ]);
-            }
-            start_idx = (start_idx + 1) % _array.size();
+void test_tiered_array_stack() {
+    std::cout << "TieredArrayStack test" << std::endl;
+    {
+        TieredArrayStack<cnt<12>> stack;
+        test_add(stack, 100);
+        test_set(stack);
+        test_remove(stack);
+    }
+    assert(cnt<12>::constructed + cnt<12>::moved + cnt<12>::copied == cnt<12>::destroyed);
+
+    for (size_t count = 1; count < 40; ++count) {
+        TieredArrayStack<pod> stack;
+        test_no_thrash(stack, count);
+    }
+
+    // random positional edits checked against std::vector while the
+    // tiers are regrouped up to 128 slots and back down
+    TieredArrayStack<size_t> stack;
+    std::vector<size_t> model;
+    uint64_t rng = 1;
+    auto next = [&rng] { rng = rng * 6364136223846793005ULL + 1442695040888963407ULL; return size_t(rng >> 33); };
+
+    for (size_t i = 0; i != 40000; ++i) {
+        bool grow = i < 20000 ? next() % 4 != 0 : next() % 4 == 0;
+        if (grow || model.empty()) {
+            size_t idx = next() % (model.size() + 1);
+            stack.add(idx, i);
+            model.insert(model.begin() + idx, i);
         } else {
-            for (size_t idx = i; idx < length - 1; ++idx) {
-                _array[ (start_idx + idx) % _array.size() ] = std::move(_array[ (start_idx + idx + 1) % _array.size() ]);
+            size_t idx = next() % model.size();
+            assert(stack.remove(idx) == model[idx]);
+            model.erase(model.begin() + idx);
+        }
+
+        if (i % 997 == 0 || model.size() < 20) {
+            assert(stack.size() == model.size());
+            assert(stack.capacity() - stack.size() <= 2 * stack.block_size());
+            for (size_t j = 0; j != model.size(); ++j) {
+                assert(stack.get(j) == model[j]);
             }
         }
+        if (i == 20000) {
+            assert(stack.block_size() == 128);
+        }
+    }
+    assert(stack.block_size() == 8);
 
-        --length;
+    std::cout << "test_tiered_array_stack > ok" << std::endl;
+}
 
-        if (_array.size() > 3 * length) {
-            resize();
-        }
+// true when the container keeps its elements inside the object itself
+template <typename Container>
+static bool stored_inline(Container& container) {
+    auto *first = reinterpret_cast<char *>(&container.get(0));
+    auto *object = reinterpret_cast<char *>(&container);
+    return first >= object && first < object + sizeof(Container);
+}
 
-        return ret;
+template <typename Container>
+static void check_sequence(Container& container, size_t first, size_t count) {
+    assert(container.size() == count);
+    for (size_t i = 0; i != count; ++i) {
+        assert(container.get(i).value == first + i);
     }
+}
 
-    private:
-    void resize() {
-        uint32_t new_size = std::max(4U, length + length/2);
-        array<T> new_array(new_size);
-
-        for (size_t i = 0; i != length; ++i) {
-            auto j = (start_idx + i) % _array.size();
-            new_array[i] = std::move(_array[j]);
+void test_inline_capacity() {
+    std::cout << "inline capacity test" << std::endl;
+    {
+        using stack_type = ArrayStack<cnt<13>, geometric_growth<>, 16>;
+        stack_type stack;
+        test_add(stack, 10);
+        assert(stack.capacity() == 16 && stored_inline(stack));
+
+        // spills to the heap and comes back once small again
+        for (size_t i = 10; i != 40; ++i) {
+            stack.add(i, cnt<13>{i});
         }
+        assert(!stored_inline(stack));
+        while (stack.size() > 5) {
+            stack.remove(stack.size() - 1);
+        }
+        assert(stack.capacity() == 16 && stored_inline(stack));
+        check_sequence(stack, 0, 5);
 
-        _array = std::move(new_array);
-        start_idx = 0;
-    }
-};
+        // inline elements are moved one by one, heap storage is stolen
+        stack_type moved(std::move(stack));
+        assert(stack.size() == 0 && stored_inline(moved));
+        check_sequence(moved, 0, 5);
 
-template <typename T, template<typename> typename Array>
-void test_add(Array<T>& stack, size_t count) {
-    for (size_t i = 0; i < count; ++i) {
-        stack.add(i, T{i});
+        stack_type big;
+        for (size_t i = 0; i != 100; ++i) {
+            big.add(i, cnt<13>{100 + i});
+        }
+        auto *heap = &big.get(0);
+        stack_type stolen(std::move(big));
+        assert(&stolen.get(0) == heap && big.size() == 0);
+
+        std::swap(moved, stolen);
+        check_sequence(moved, 100, 100);
+        check_sequence(stolen, 0, 5);
+        assert(stored_inline(stolen) && &moved.get(0) == heap);
+
+        stolen = std::move(moved);
+        check_sequence(stolen, 100, 100);
+        moved = std::move(stack);
+        assert(moved.size() == 0);
+        moved.add(0, cnt<13>{1});
+        assert(stored_inline(moved));
     }
+    assert(cnt<13>::constructed + cnt<13>::moved + cnt<13>::copied == cnt<13>::destroyed);
 
-    assert(stack.size() == count);
-    for (size_t i = 0; i < count; ++i) {
-        assert(stack.get(i).value == i);
+    {
+        FastArrayStack<pod, geometric_growth<>, 8> fast;
+        for (size_t i = 0; i != 20; ++i) {
+            fast.add(0, pod{19 - i});
+        }
+        assert(!stored_inline(fast));
+        fast.shrink_to_fit();
+        while (fast.size() > 2) {
+            fast.remove(0);
+        }
+        assert(stored_inline(fast) && fast.get(0).value == 18 && fast.get(1).value == 19);
     }
-    std::cout << "test_add > " << stack.get(0) << std::endl;
-}
 
-template <typename T, template<typename> typename Array>
-void test_set(Array<T>& stack) {
-    stack.get(0) = T(23);
-    stack.get(stack.size() - 1) = T(32);
+    {
+        using queue_type = ArrayQueue<cnt<14>, true, 8>;
+        queue_type queue;
+        // walk the start around the inline ring
+        for (size_t i = 0; i != 30; ++i) {
+            queue.add(cnt<14>{i});
+            if (i >= 5) {
+                assert(queue.remove().value == i - 5);
+            }
+        }
+        assert(stored_inline(queue));
+        check_sequence(queue, 25, 5);
 
-    assert(stack.get(0).value == 23);
-    assert(stack.get(stack.size() - 1).value == 32);
+        queue_type moved(std::move(queue));
+        assert(queue.size() == 0 && stored_inline(moved));
+        check_sequence(moved, 25, 5);
 
-    std::cout << "test_set > " << stack.get(0) << std::endl;
+        queue_type big;
+        for (size_t i = 0; i != 50; ++i) {
+            big.add(cnt<14>{i});
+        }
+        std::swap(moved, big);
+        check_sequence(moved, 0, 50);
+        check_sequence(big, 25, 5);
+        assert(!stored_inline(moved) && stored_inline(big));
+
+        while (moved.size() > 3) {
+            moved.remove();
+        }
+        assert(stored_inline(moved));
+        check_sequence(moved, 47, 3);
+    }
+    assert(cnt<14>::constructed + cnt<14>::moved + cnt<14>::copied == cnt<14>::destroyed);
+
+    std::cout << "test_inline_capacity > stack: " << sizeof(ArrayStack<uint64_t, geometric_growth<>, 16>)
+              << " bytes, queue: " << sizeof(ArrayQueue<uint64_t, false, 16>) << " bytes" << std::endl;
 }
 
-template <typename T, template<typename> typename Array>
-void test_remove(Array<T>& stack) {
-    auto size = stack.size();
-    stack.remove(0);
-    stack.remove(stack.size()-1);
+// a stack kept in a file survives being closed and reopened
+void test_mapped_array_stack() {
+    std::cout << "MappedArrayStack test" << std::endl;
+    std::string path = "/tmp/ds_playground_mapped." + std::to_string(::getpid());
+    ::unlink(path.c_str());
 
-    assert(stack.size() == size - 2);
+    {
+        MappedArrayStack<pod> stack(path);
+        for (size_t i = 0; i != 10000; ++i) {
+            stack.add(i, pod{i});
+        }
+        for (size_t i = 0; i != 100; ++i) {
+            stack.remove(0);
+        }
+        stack.add(0, pod{99});
+        stack.advise(MADV_SEQUENTIAL);
+        stack.flush();
+    }
 
-    for (size_t i = 0; i < stack.size(); ++i) {
-        assert(stack.get(i).value == i + 1);
+    {
+        MappedArrayStack<pod> stack(path);
+        assert(stack.size() == 9901);
+        for (size_t i = 0; i != stack.size(); ++i) {
+            assert(stack.get(i).value == i + 99);
+        }
+
+        // shrinking truncates the file, remapping keeps the contents
+        while (stack.size() > 10) {
+            stack.remove(stack.size() - 1);
+        }
+        assert(stack.capacity() < 100);
+        stack.shrink_to_fit();
+        assert(stack.capacity() == 10 && stack.get(9).value == 108);
     }
 
-    std::cout << "test_remove > " << stack.get(0) << std::endl;
-}
+    // a reallocate cut short by a crash leaves the file longer than its
+    // header says; reopening accepts it and truncates the tail
+    struct stat st;
+    assert(::stat(path.c_str(), &st) == 0);
+    off_t written = st.st_size;
+    assert(::truncate(path.c_str(), written + 5 * 4096 + 123) == 0);
+    {
+        MappedArrayStack<pod> stack(path);
+        assert(stack.size() == 10 && stack.capacity() == 10);
+        for (size_t i = 0; i != stack.size(); ++i) {
+            assert(stack.get(i).value == i + 99);
+        }
+        assert(::stat(path.c_str(), &st) == 0 && st.st_size == written);
 
-void test_vector(size_t count) {
-    std::vector<cnt<1>> stack;
-    for (size_t i = 0; i < count; ++i) {
-        stack.push_back(cnt<1>());
+        stack.add(stack.size(), pod{109});
+        assert(stack.capacity() > 10 && stack.get(10).value == 109);
     }
 
-    std::cout << "test_vector > " << stack[0] << std::endl;
-}
+    // a full disk, here a file size limit, fails the grow but leaves the
+    // stack usable with its old capacity and contents
+    {
+        ::unlink(path.c_str());
+        MappedArrayStack<uint64_t> stack(path);
+        for (uint64_t i = 0; i != 100; ++i) {
+            stack.add(i, i);
+        }
+        uint32_t capacity = stack.capacity();
+
+        auto old_handler = std::signal(SIGXFSZ, SIG_IGN);
+        struct rlimit old_limit;
+        assert(::getrlimit(RLIMIT_FSIZE, &old_limit) == 0);
+        struct rlimit limit = old_limit;
+        limit.rlim_cur = 8192;
+        assert(::setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+        bool failed = false;
+        try {
+            stack.reserve(100000);
+        } catch (const std::system_error&) {
+            failed = true;
+        }
 
-void test_array_stack() {
-    std::cout << "ArrayStack test" << std::endl;
-    ArrayStack<cnt<0>> stack(4);
+        assert(::setrlimit(RLIMIT_FSIZE, &old_limit) == 0);
+        std::signal(SIGXFSZ, old_handler);
 
-    test_add(stack, 6);
-    test_vector(6);
-    test_set(stack);
-    test_remove(stack);
+        assert(failed);
+        assert(stack.size() == 100 && stack.capacity() == capacity);
+        for (uint64_t i = 0; i != 100; ++i) {
+            assert(stack.get(i) == i);
+        }
+        stack.flush();
+        stack.reserve(100000);
+        stack.add(100, 100);
+        assert(stack.capacity() == 100000 && stack.get(99) == 99 && stack.get(100) == 100);
+    }
+
+    bool rejected = false;
+    try {
+        MappedArrayStack<uint32_t> other(path);
+    } catch (const std::system_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    ::unlink(path.c_str());
+    std::cout << "test_mapped_array_stack > ok" << std::endl;
 }
 
-void test_fast_array_stack() {
-    std::cout << "FastArrayStack test" << std::endl;
-    FastArrayStack<cnt<2>> stack(4);
+// crc32 lookup table filled during compilation
+static constexpr auto crc_table = [] {
+    StaticArrayStack<uint32_t, 256> table;
+    for (uint32_t i = 0; i != 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k != 8; ++k) {
+            c = c & 1 ? 0xedb88320U ^ (c >> 1) : c >> 1;
+        }
+        table.add(i, c);
+    }
+    return table;
+}();
+
+static_assert(crc_table.size() == 256 && crc_table.get(1) == 0x77073096U && crc_table.get(255) == 0x2d02ef8dU);
+static_assert(sizeof(StaticArrayStack<uint32_t, 16>) == 17 * sizeof(uint32_t));
+
+// a ring that wraps and shifts both ways, evaluated by the compiler
+static constexpr uint32_t static_ring_digits() {
+    StaticArrayQueue<uint32_t, 5> queue{1, 2, 3};
+    queue.add(4);
+    queue.add_front(0);
+    queue.remove();
+    queue.remove();
+    queue.add(5);
+    queue.add(6);
+    queue.remove(2);
+    queue.add(1, 7);
 
-    test_add(stack, 6);
-    test_vector(6);
-    test_set(stack);
-    test_remove(stack);
+    uint32_t digits = 0;
+    for (size_t i = 0; i != queue.size(); ++i) {
+        digits = digits * 10 + queue.get(i);
+    }
+    return digits;
 }
 
-template <typename T, template <typename> typename Queue>
-void test_queue_add(Queue<T>& queue, size_t count) {
-    for (size_t i = 0; i < count; ++i) {
-        queue.add(T{i});
+static_assert(static_ring_digits() == 27356);
+
+void test_static_containers() {
+    std::cout << "static containers test" << std::endl;
+    {
+        StaticArrayStack<cnt<16>, 8> stack;
+        test_add(stack, 6);
+        test_set(stack);
+        test_remove(stack);
+        stack.add(2, cnt<16>{9});
+        while (!stack.full()) {
+            stack.add(stack.size(), cnt<16>{10});
+        }
+        assert(stack.full() && stack.get(2).value == 9 && stack.get(7).value == 10);
+    }
+    {
+        StaticArrayQueue<cnt<17>, 6> queue;
+        test_queue_add(queue, 6);
+        assert(queue.full());
+        test_queue_remove(queue, 6);
+        test_queue_positional_add_remove(queue);
     }
 
-    assert(queue.size() == count);
-    for (size_t i = 0; i < count; ++i) {
-        assert(queue.get(i).value == i);
+    // removed slots give their resources back
+    StaticArrayQueue<std::string, 8> ring;
+    std::deque<std::string> model;
+    uint64_t rng = 11;
+    for (size_t i = 0; i != 20000; ++i) {
+        rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+        size_t roll = (rng >> 33) % 6;
+        std::string value(i % 50, char('a' + i % 26));
+        if (roll == 0 && !ring.full()) {
+            ring.add_front(value);
+            model.push_front(value);
+        } else if (roll == 1 && !ring.full()) {
+            size_t at = (rng >> 40) % (ring.size() + 1);
+            ring.add(at, value);
+            model.insert(model.begin() + at, value);
+        } else if (roll == 2 && !ring.empty()) {
+            size_t at = (rng >> 40) % ring.size();
+            assert(ring.remove(at) == model[at]);
+            model.erase(model.begin() + at);
+        } else if (roll == 3 && !ring.empty()) {
+            assert(ring.remove_back() == model.back());
+            model.pop_back();
+        } else if (roll == 4 && !ring.empty()) {
+            assert(ring.remove() == model.front());
+            model.pop_front();
+        } else if (!ring.full()) {
+            ring.add(value);
+            model.push_back(value);
+        }
+        assert(ring.size() == model.size());
+        for (size_t j = 0; j != model.size(); ++j) {
+            assert(ring.get(j) == model[j]);
+        }
     }
-    std::cout << "test_queue_add > " << queue.get(0) << std::endl;
+
+    std::cout << "test_static_containers > crc32 table: " << crc_table.size() << " entries, no heap" << std::endl;
 }
 
-template <typename T, template<typename> typename Queue>
-void test_queue_remove(Queue<T>& queue, size_t count) {
-    assert(queue.size() == count);
+void test_spsc_queue() {
+    std::cout << "SpscArrayQueue test" << std::endl;
+    // the aligned members alone keep the tail's line away from whatever follows
+    static_assert(sizeof(SpscArrayQueue<cnt<11>>) % cache_line_size == 0);
+    SpscArrayQueue<cnt<11>> queue(6);
+    assert(queue.capacity() == 8);
 
-    for (size_t i = 0; i < count; ++i) {
-        assert(queue.remove().value == i);
+    for (size_t i = 0; i < 8; ++i) {
+        assert(queue.try_add(cnt<11>{i}));
     }
+    assert(!queue.try_add(cnt<11>{8}));
 
-    assert(queue.size() == 0);
+    cnt<11> out;
+    for (size_t i = 0; i < 5; ++i) {
+        assert(queue.try_remove(out) && out.value == i);
+    }
 
-    std::cout << "test_queue_remove > " << T() << std::endl;
-}
+    std::vector<cnt<11>> batch;
+    for (size_t i = 8; i < 14; ++i) {
+        batch.emplace_back(i);
+    }
+    // only 5 free slots, the batch wraps around the end of the ring
+    assert(queue.try_add_n(batch.begin(), batch.size()) == 5);
 
-template <typename T, template<typename> typename Queue>
-void test_queue_positional_add_remove(Queue<T>& queue) {
-    assert(queue.size() == 0);
+    std::vector<cnt<11>> drained(10);
+    assert(queue.try_remove_n(drained.begin(), drained.size()) == 8);
+    for (size_t i = 0; i < 8; ++i) {
+        assert(drained[i].value == i + 5);
+    }
+    assert(!queue.try_remove(out));
+    assert(cnt<11>::copied == 0);
+    std::cout << "test_spsc_queue > " << out << std::endl;
+}
 
-    queue.add(0, T{0});
-    queue.add(1, T{1});
-    queue.add(2, T{2});
+struct message {
+    uint64_t seq;
+    int64_t sent_ns;
+};
 
-    queue.add(0, T{3});
-    queue.add(1, T{4});
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-    assert(queue.get(0).value == 3);
-    assert(queue.get(1).value == 4);
-    assert(queue.get(2).value == 0);
-    assert(queue.get(3).value == 1);
-    assert(queue.get(4).value == 2);
+// streams `count` messages from a producer thread to a consumer thread,
+// checks FIFO order and reports throughput and hand-off latency
+template <typename TryAdd, typename TryRemove>
+void run_handoff(const char *name, size_t count, TryAdd try_add, TryRemove try_remove) {
+    int64_t latency_sum = 0;
+    int64_t latency_max = 0;
+    auto start = now_ns();
+
+    std::thread consumer([&] {
+        message msg;
+        for (uint64_t expected = 0; expected != count; ++expected) {
+            while (!try_remove(msg)) {
+                std::this_thread::yield();
+            }
+            assert(msg.seq == expected);
+            int64_t latency = now_ns() - msg.sent_ns;
+            latency_sum += latency;
+            latency_max = std::max(latency_max, latency);
+        }
+    });
 
-    queue.remove(2);
-    queue.remove(3);
-    queue.remove(2);
-    queue.remove(0);
-    queue.remove(0);
+    for (uint64_t seq = 0; seq != count; ++seq) {
+        while (!try_add(message{seq, now_ns()})) {
+            std::this_thread::yield();
+        }
+    }
 
-    assert(queue.size() == 0);
+    consumer.join();
+    auto elapsed = now_ns() - start;
 
-    std::cout << "test_queue_positional_add_remove > " << T() << std::endl;
+    std::cout << name << " > " << count * 1e3 / elapsed << " Mmsg/s"
+              << ", avg latency: " << latency_sum / int64_t(count) << " ns"
+              << ", max latency: " << latency_max << " ns" << std::endl;
 }
 
-void test_queue() {
-    std::cout << "ArrayQueue test" << std::endl;
-    ArrayQueue<cnt<3>> queue(4);
+void test_spsc_handoff() {
+    std::cout << "SpscArrayQueue hand-off test" << std::endl;
+    const size_t count = 1000000;
 
-    test_queue_add(queue, 6);
-    test_queue_remove(queue, 6);
-    test_queue_positional_add_remove(queue);
+    {
+        SpscArrayQueue<message> queue(1024);
+        run_handoff("spsc", count,
+                    [&](message msg) { return queue.try_add(msg); },
+                    [&](message& msg) { return queue.try_remove(msg); });
+    }
+
+    {
+        std::mutex mutex;
+        ArrayQueue<message, true> queue(1024);
+        run_handoff("mutex + ArrayQueue", count,
+                    [&](message msg) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (queue.size() == 1024) {
+                            return false;
+                        }
+                        queue.add(msg);
+                        return true;
+                    },
+                    [&](message& msg) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (queue.empty()) {
+                            return false;
+                        }
+                        msg = queue.remove();
+                        return true;
+                    });
+    }
 }
 
 void _main() {
     test_array_stack();
     test_fast_array_stack();
     test_queue();
+    test_raw_storage();
+    test_relocation();
+    test_growth_policy();
+    test_tiered_array_stack();
+    test_inline_capacity();
+    test_mapped_array_stack();
+    test_static_containers();
+    test_power_of_two_queue();
+    test_bulk_queue();
+    test_double_ended_queue();
+    test_spsc_queue();
+    test_spsc_handoff();
     // std::cout << cnt<0>() << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,1089 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// an object is trivially relocatable when moving it to a new address and
+// forgetting the old one is the same as copying its bytes.
+// specialize for own types that qualify, e.g. ones holding only owning pointers
+template <typename T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+
+template <typename T>
+constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+// slots kept inside the owning object, empty when N is 0
+template <typename T, uint32_t N>
+struct inline_slots {
+    alignas(T) unsigned char bytes[N * sizeof(T)];
+
+    T* slots() {
+        return reinterpret_cast<T*>(bytes);
+    }
+
+    const T* slots() const {
+        return reinterpret_cast<const T*>(bytes);
+    }
+};
+
+template <typename T>
+struct inline_slots<T, 0> {
+    T* slots() {
+        return nullptr;
+    }
+
+    const T* slots() const {
+        return nullptr;
+    }
+};
+
+// raw storage for `length` objects of T, slots are left uninitialized
+// and the owning container decides which of them hold live objects.
+// with Inline != 0 the first Inline slots live inside the object and the
+// heap is only used past them, so small containers never allocate. the
+// array can't move objects it doesn't know about: when inline storage is
+// moved, the owner moves its live objects itself (see is_inline)
+template <typename T, uint32_t Inline = 0>
+class array : inline_slots<T, Inline> {
+    T *storage{nullptr};
+    uint32_t length{0};
+    public:
+    array(uint32_t length): length(length) {
+        assert(length != 0);
+        if (length <= Inline) {
+            storage = this->slots();
+            this->length = Inline;
+        } else {
+            storage = allocate(length);
+        }
+    }
+
+    ~array() {
+        release();
+    }
+
+    T& operator [] (size_t idx) {
+        return storage[idx];
+    }
+
+    T* data() {
+        return storage;
+    }
+
+    const T* data() const {
+        return storage;
+    }
+
+    uint32_t size() const {
+        return length;
+    }
+
+    bool is_inline() const {
+        return Inline != 0 && storage == const_cast<array *>(this)->slots();
+    }
+
+    template <typename... Args>
+    T& construct(size_t idx, Args&&... args) {
+        return *new (storage + idx) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(size_t idx) {
+        storage[idx].~T();
+    }
+
+    // resizes the buffer keeping its bytes, in place when the allocator can.
+    // only for trivially relocatable T: live objects simply change address
+    void reallocate(uint32_t new_length) {
+        static_assert(is_trivially_relocatable_v<T>, "reallocate moves objects bytewise");
+        assert(new_length != 0);
+
+        if constexpr (Inline != 0) {
+            if (is_inline() || new_length <= Inline) {
+                relocate(new_length, [this](T *from, T *to, uint32_t new_length) {
+                    std::memcpy(static_cast<void*>(to), from, sizeof(T) * std::min(length, new_length));
+                });
+                return;
+            }
+        }
+
+        if constexpr (malloc_aligned) {
+            void *ptr = std::realloc(static_cast<void*>(storage), sizeof(T) * new_length);
+            if (ptr == nullptr) {
+                throw std::bad_alloc();
+            }
+            storage = static_cast<T*>(ptr);
+        } else {
+            T *new_storage = allocate(new_length);
+            std::memcpy(static_cast<void*>(new_storage), storage, sizeof(T) * std::min(length, new_length));
+            release();
+            storage = new_storage;
+        }
+
+        length = new_length;
+    }
+
+    // switches to a buffer of new_length slots, the inline one when it is
+    // big enough. move(from, to, new_length) must move the live objects
+    // from the old buffer to the new one and destroy the old ones
+    template <typename Move>
+    void relocate(uint32_t new_length, Move move) {
+        new_length = std::max(new_length, Inline);
+        assert(new_length != 0);
+        if (is_inline() && new_length == Inline) {
+            return;
+        }
+
+        T *new_storage = new_length == Inline ? this->slots() : allocate(new_length);
+        move(storage, new_storage, new_length);
+        release();
+        storage = new_storage;
+        length = new_length;
+    }
+
+    // steals heap storage. inline storage stays behind: the new array
+    // gets its own inline slots and the owner moves the objects over
+    array(array&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    array& operator = (array&& rhs) noexcept {
+        release();
+
+        if (rhs.is_inline()) {
+            storage = this->slots();
+            length = Inline;
+        } else {
+            storage = rhs.storage;
+            length = rhs.length;
+            rhs.storage = rhs.slots();
+            rhs.length = Inline;
+        }
+        return *this;
+    }
+
+    array(const array&) = delete;
+    array& operator = (const array&) = delete;
+
+    private:
+    // malloc'ed storage can be grown with realloc, over-aligned types can't
+    static constexpr bool malloc_aligned = alignof(T) <= alignof(std::max_align_t);
+
+    static T* allocate(uint32_t length) {
+        if constexpr (malloc_aligned) {
+            void *ptr = std::malloc(sizeof(T) * length);
+            if (ptr == nullptr) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(ptr);
+        } else {
+            return static_cast<T*>(::operator new(sizeof(T) * length, std::align_val_t(alignof(T))));
+        }
+    }
+
+    void release() {
+        if (storage == nullptr || is_inline()) {
+            return;
+        }
+
+        if constexpr (malloc_aligned) {
+            std::free(storage);
+        } else {
+            ::operator delete(storage, std::align_val_t(alignof(T)));
+        }
+    }
+};
+
+// growth policies pick the capacity of an ArrayStack at compile time.
+// a policy is any type with two static functions:
+//   grow(capacity, required)  - new capacity (>= required) when the stack is full
+//   shrink(capacity, length)  - capacity to keep after a removal, returning
+//                               `capacity` leaves the storage untouched
+
+// grows by Num/Den and shrinks once capacity reaches ShrinkRatio * length.
+// ShrinkRatio must exceed the growth factor so a shrunk stack is neither
+// full nor immediately shrinkable again, otherwise add/remove near the
+// threshold would reallocate on every call
+template <uint32_t Num = 3, uint32_t Den = 2, uint32_t ShrinkRatio = 3, uint32_t MinCapacity = 4>
+struct geometric_growth {
+    static_assert(Num > Den, "growth factor must be above 1");
+    static_assert(ShrinkRatio * Den > Num, "shrink threshold must leave hysteresis after growth");
+
+    static uint32_t grow(uint32_t capacity, uint32_t required) {
+        uint64_t next = uint64_t(capacity) * Num / Den;
+        return std::max({MinCapacity, required, uint32_t(std::min<uint64_t>(next, UINT32_MAX))});
+    }
+
+    static uint32_t shrink(uint32_t capacity, uint32_t length) {
+        if (capacity <= MinCapacity || capacity < uint64_t(ShrinkRatio) * length) {
+            return capacity;
+        }
+
+        return std::max(MinCapacity, uint32_t(uint64_t(length) * Num / Den));
+    }
+};
+
+template <typename Growth = geometric_growth<>>
+struct never_shrink {
+    static uint32_t grow(uint32_t capacity, uint32_t required) {
+        return Growth::grow(capacity, required);
+    }
+
+    static uint32_t shrink(uint32_t capacity, uint32_t) {
+        return capacity;
+    }
+};
+
+// with Inline != 0 up to Inline elements are stored inside the stack
+// itself and the heap is only used once it grows past them
+template <typename T, typename Policy = geometric_growth<>, uint32_t Inline = 0>
+class ArrayStack {
+    protected:
+    array<T, Inline> _array;
+    uint32_t length{0};
+
+    public:
+    using value_type = T;
+    using policy_type = Policy;
+
+    ArrayStack(): _array(Inline != 0 ? Inline : 4) {
+    }
+
+    ArrayStack(uint32_t capacity): _array(capacity) {
+    }
+
+    ArrayStack(ArrayStack&& rhs) noexcept: _array(std::move(rhs._array)), length(rhs.length) {
+        take_inline(rhs);
+    }
+
+    ArrayStack& operator = (ArrayStack&& rhs) noexcept {
+        clear();
+        _array = std::move(rhs._array);
+        length = rhs.length;
+        take_inline(rhs);
+        return *this;
+    }
+
+    ~ArrayStack() {
+        clear();
+    }
+
+    uint32_t size() const {
+        return length;
+    }
+
+    uint32_t capacity() const {
+        return _array.size();
+    }
+
+    T& get(size_t idx) {
+        return _array[idx];
+    }
+
+    T set(size_t idx, const T& val) {
+        T tmp = std::move(_array[idx]);
+        _array[idx] = val;
+        return tmp;
+    }
+
+    T set(size_t idx, T&& val) noexcept {
+        T tmp = std::move(_array[idx]);
+        _array[idx] = std::move(val);
+        return tmp;
+    }
+
+    void add(size_t idx, T val) {
+        if (length + 1 > _array.size()) {
+            resize(Policy::grow(_array.size(), length + 1));
+        }
+
+        if (idx == length) {
+            _array.construct(length, std::move(val));
+        } else {
+            // the slot past the end is raw storage, so the last element is moved into it
+            _array.construct(length, std::move(_array[length - 1]));
+            for (size_t i = length - 1; i > idx; --i) {
+                _array[i] = std::move(_array[i - 1]);
+            }
+
+            _array[idx] = std::move(val);
+        }
+
+        ++length;
+    }
+
+    T remove(size_t idx) {
+        T tmp = std::move(_array[idx]);
+
+        for (size_t i = idx; i < length - 1; ++i) {
+            _array[i] = std::move(_array[i + 1]);
+        }
+
+        _array.destroy(length - 1);
+        --length;
+
+        shrink();
+
+        return tmp;
+    }
+
+    void reserve(uint32_t capacity) {
+        if (capacity > _array.size()) {
+            resize(capacity);
+        }
+    }
+
+    void shrink_to_fit() {
+        uint32_t capacity = std::max(1U, length);
+        if (capacity != _array.size()) {
+            resize(capacity);
+        }
+    }
+
+    protected:
+    void clear() {
+        for (size_t i = 0; i < length; ++i) {
+            _array.destroy(i);
+        }
+        length = 0;
+    }
+
+    // after the storage was moved from rhs, brings over the elements that
+    // were still inline in rhs
+    void take_inline(ArrayStack& rhs) {
+        if (_array.is_inline()) {
+            for (size_t i = 0; i < length; ++i) {
+                _array.construct(i, std::move(rhs._array[i]));
+                rhs._array.destroy(i);
+            }
+        }
+        rhs.length = 0;
+    }
+
+    void shrink() {
+        uint32_t capacity = std::max(Inline, Policy::shrink(_array.size(), length));
+        if (capacity != _array.size()) {
+            resize(capacity);
+        }
+    }
+
+    void resize(uint32_t new_size) {
+        _array.relocate(new_size, [this](T *from, T *to, uint32_t) {
+            for (size_t i = 0; i < length; ++i) {
+                new (to + i) T(std::move(from[i]));
+                from[i].~T();
+            }
+        });
+    }
+};
+
+// ArrayStack that relocates trivially relocatable elements with
+// memmove/realloc instead of moving them one by one
+template <typename T, typename Policy = geometric_growth<>, uint32_t Inline = 0>
+class FastArrayStack : public ArrayStack<T, Policy, Inline> {
+    using base = ArrayStack<T, Policy, Inline>;
+    static constexpr bool relocatable = is_trivially_relocatable_v<T>;
+
+    public:
+    FastArrayStack() {}
+
+    FastArrayStack(uint32_t capacity): base(capacity) {}
+
+    void add(size_t idx, T val) {
+        if constexpr (!relocatable) {
+            base::add(idx, std::move(val));
+        } else {
+            if (this->length + 1 > this->_array.size()) {
+                resize(Policy::grow(this->_array.size(), this->length + 1));
+            }
+
+            T *first = this->_array.data();
+            std::memmove(static_cast<void*>(first + idx + 1), first + idx, (this->length - idx) * sizeof(T));
+            this->_array.construct(idx, std::move(val));
+            ++this->length;
+        }
+    }
+
+    T remove(size_t idx) {
+        if constexpr (!relocatable) {
+            return base::remove(idx);
+        } else {
+            T *first = this->_array.data();
+            T tmp = std::move(first[idx]);
+            this->_array.destroy(idx);
+            std::memmove(static_cast<void*>(first + idx), first + idx + 1, (this->length - idx - 1) * sizeof(T));
+            --this->length;
+
+            uint32_t capacity = std::max(Inline, Policy::shrink(this->_array.size(), this->length));
+            if (capacity != this->_array.size()) {
+                resize(capacity);
+            }
+
+            return tmp;
+        }
+    }
+
+    void reserve(uint32_t capacity) {
+        if (capacity > this->_array.size()) {
+            resize(capacity);
+        }
+    }
+
+    void shrink_to_fit() {
+        uint32_t capacity = std::max(1U, this->length);
+        if (capacity != this->_array.size()) {
+            resize(capacity);
+        }
+    }
+
+    protected:
+    void resize(uint32_t new_size) {
+        if constexpr (relocatable) {
+            this->_array.reallocate(new_size);
+        } else {
+            base::resize(new_size);
+        }
+    }
+};
+
+// ArrayStack split into tiers of b = 2^k slots, each one a ring buffer,
+// with b kept close to sqrt(n). all tiers but the last are full, so
+// element i sits in tier i / b. add(idx) shifts the rest of its own tier
+// and then hands one element down the tiers: the back of a full ring
+// becomes the front of the next one by moving the ring's start, so a
+// positional add/remove costs O(b + n / b) = O(sqrt n) moves instead of
+// O(n). growing never copies the whole stack: a tier is allocated when
+// the last one fills, and when the tier count passes 2b the tiers are
+// regrouped one at a time into tiers of 2b (split again when n drops), so
+// only O(sqrt n) slots are ever unused or duplicated
+template <typename T>
+class TieredArrayStack {
+    struct tier {
+        array<T> slots;
+        uint32_t start{0};
+
+        tier(uint32_t size): slots(size) {}
+    };
+
+    std::vector<tier> tiers;
+    uint32_t length{0};
+    uint32_t shift{min_shift};
+
+    static constexpr uint32_t min_shift = 3;
+
+    public:
+    using value_type = T;
+
+    TieredArrayStack() {}
+
+    TieredArrayStack(const TieredArrayStack&) = delete;
+    TieredArrayStack& operator = (const TieredArrayStack&) = delete;
+
+    ~TieredArrayStack() {
+        destroy_values();
+    }
+
+    uint32_t size() const {
+        return length;
+    }
+
+    uint32_t capacity() const {
+        return uint32_t(tiers.size()) << shift;
+    }
+
+    uint32_t block_size() const {
+        return 1U << shift;
+    }
+
+    T& get(size_t idx) {
+        tier& t = tiers[idx >> shift];
+        return t.slots[(t.start + idx) & mask()];
+    }
+
+    T set(size_t idx, const T& val) {
+        T tmp = std::move(get(idx));
+        get(idx) = val;
+        return tmp;
+    }
+
+    T set(size_t idx, T&& val) noexcept {
+        T tmp = std::move(get(idx));
+        get(idx) = std::move(val);
+        return tmp;
+    }
+
+    void add(size_t idx, T val) {
+        assert(idx <= length);
+
+        if (length == capacity()) {
+            if (tiers.size() == 2 * block_size()) {
+                regroup(shift + 1);
+            }
+            tiers.emplace_back(block_size());
+        }
+
+        size_t last = tiers.size() - 1;
+        size_t k = idx >> shift;
+        uint32_t j = idx & mask();
+
+        if (k == last) {
+            tier& back = tiers[last];
+            uint32_t count = length & mask();
+            if (j == count) {
+                back.slots.construct(slot(back, count), std::move(val));
+            } else {
+                // the slot past the end is raw storage, so the last element is moved into it
+                back.slots.construct(slot(back, count), std::move(back.slots[slot(back, count - 1)]));
+                for (uint32_t i = count - 1; i > j; --i) {
+                    back.slots[slot(back, i)] = std::move(back.slots[slot(back, i - 1)]);
+                }
+                back.slots[slot(back, j)] = std::move(val);
+            }
+        } else {
+            tier& t = tiers[k];
+            T carry = std::move(t.slots[slot(t, mask())]);
+            for (uint32_t i = mask(); i > j; --i) {
+                t.slots[slot(t, i)] = std::move(t.slots[slot(t, i - 1)]);
+            }
+            t.slots[slot(t, j)] = std::move(val);
+
+            // a full ring turns its back slot into its front
+            for (size_t m = k + 1; m != last; ++m) {
+                tier& full = tiers[m];
+                full.start = (full.start - 1) & mask();
+                std::swap(carry, full.slots[full.start]);
+            }
+
+            tier& back = tiers[last];
+            back.start = (back.start - 1) & mask();
+            back.slots.construct(back.start, std::move(carry));
+        }
+
+        ++length;
+    }
+
+    T remove(size_t idx) {
+        assert(idx < length);
+
+        // an empty last tier is kept until the one before it shrinks, so
+        // add/remove around a tier boundary doesn't allocate every time
+        if (length == (tiers.size() - 1) << shift) {
+            tiers.pop_back();
+        }
+
+        size_t last = tiers.size() - 1;
+        size_t k = idx >> shift;
+        uint32_t j = idx & mask();
+        uint32_t count = length - uint32_t(last << shift);
+
+        tier& t = tiers[k];
+        T ret = std::move(t.slots[slot(t, j)]);
+
+        if (k == last) {
+            for (uint32_t i = j; i + 1 < count; ++i) {
+                t.slots[slot(t, i)] = std::move(t.slots[slot(t, i + 1)]);
+            }
+            t.slots.destroy(slot(t, count - 1));
+        } else {
+            for (uint32_t i = j; i != mask(); ++i) {
+                t.slots[slot(t, i)] = std::move(t.slots[slot(t, i + 1)]);
+            }
+
+            // the front of each following ring fills the hole and becomes its back
+            T *hole = &t.slots[slot(t, mask())];
+            for (size_t m = k + 1; m != last; ++m) {
+                tier& full = tiers[m];
+                *hole = std::move(full.slots[full.start]);
+                hole = &full.slots[full.start];
+                full.start = (full.start + 1) & mask();
+            }
+
+            tier& back = tiers[last];
+            *hole = std::move(back.slots[back.start]);
+            back.slots.destroy(back.start);
+            back.start = (back.start + 1) & mask();
+        }
+
+        --length;
+
+        if (shift > min_shift && 4 * tiers.size() < block_size()) {
+            regroup(shift - 1);
+        }
+
+        return ret;
+    }
+
+    private:
+    uint32_t mask() const {
+        return (1U << shift) - 1;
+    }
+
+    static uint32_t slot(const tier& t, uint32_t i, uint32_t mask) {
+        return (t.start + i) & mask;
+    }
+
+    uint32_t slot(const tier& t, uint32_t i) const {
+        return slot(t, i, mask());
+    }
+
+    // moves every element into tiers of 2^new_shift slots. each old tier is
+    // freed as soon as it has been emptied
+    void regroup(uint32_t new_shift) {
+        uint32_t old_mask = mask();
+        uint32_t new_mask = (1U << new_shift) - 1;
+
+        std::vector<tier> regrouped;
+        regrouped.reserve((length >> new_shift) + 2);
+
+        uint32_t moved = 0;
+        for (auto& t : tiers) {
+            tier old = std::move(t);
+            uint32_t count = std::min(old_mask + 1, length - moved);
+            for (uint32_t i = 0; i != count; ++i, ++moved) {
+                if ((moved & new_mask) == 0) {
+                    regrouped.emplace_back(new_mask + 1);
+                }
+                uint32_t from = slot(old, i, old_mask);
+                regrouped.back().slots.construct(moved & new_mask, std::move(old.slots[from]));
+                old.slots.destroy(from);
+            }
+        }
+
+        tiers = std::move(regrouped);
+        shift = new_shift;
+    }
+
+    void destroy_values() {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (size_t m = 0; m != tiers.size(); ++m) {
+                uint32_t count = std::min(block_size(), length - uint32_t(m << shift));
+                for (uint32_t i = 0; i != count; ++i) {
+                    tiers[m].slots.destroy(slot(tiers[m], i));
+                }
+            }
+        }
+    }
+};
+
+// smallest power of two >= n, 1 for 0. anything above 2^31 has no
+// 32-bit answer
+inline uint32_t round_up_pow2(uint32_t n) {
+    assert(n <= (1U << 31) && "capacity has no power of two in 32 bits");
+    return n <= 1 ? 1 : 1U << (32 - __builtin_clz(n - 1));
+}
+
+// ring buffer deque, O(1) at both ends. with PowerOfTwo the capacity is
+// kept at a power of two so wrapping an index is a bitmask instead of an
+// integer division. with Inline != 0 the first Inline slots are kept
+// inside the queue
+template <typename T, bool PowerOfTwo = false, uint32_t Inline = 0>
+class ArrayQueue {
+    static_assert(!PowerOfTwo || (Inline & (Inline - 1)) == 0, "inline capacity must be a power of two");
+
+    array<T, Inline> _array;
+    size_t start_idx{0};
+    uint32_t length{0};
+    public:
+    using value_type = T;
+
+    ArrayQueue(): _array(Inline != 0 ? Inline : 4) {}
+    ArrayQueue(uint32_t capacity) : _array(round_capacity(capacity)) {}
+
+    ArrayQueue(ArrayQueue&& rhs) noexcept: _array(std::move(rhs._array)), start_idx(rhs.start_idx), length(rhs.length) {
+        take_inline(rhs);
+    }
+
+    ArrayQueue& operator = (ArrayQueue&& rhs) noexcept {
+        clear();
+        _array = std::move(rhs._array);
+        start_idx = rhs.start_idx;
+        length = rhs.length;
+        take_inline(rhs);
+        return *this;
+    }
+
+    ~ArrayQueue() {
+        clear();
+    }
+
+    template <typename U>
+    void add(U&& val) {
+        if (length + 1 > _array.size()) {
+            resize(grown_capacity(length + 1));
+        }
+
+        _array.construct(wrap(start_idx + length), std::move(val));
+        ++length;
+    }
+
+    template <typename U>
+    void add(size_t i, U&& val) {
+        assert(i <= length);
+
+        if (length + 1 > _array.size()) {
+            resize(grown_capacity(length + 1));
+        }
+
+        if (i < length / 2) {
+            // move elements to the left, the new front slot is raw storage
+            start_idx = wrap(start_idx + _array.size() - 1);
+            if (i == 0) {
+                _array.construct(start_idx, std::move(val));
+            } else {
+                _array.construct(start_idx, std::move(_array[ wrap(start_idx + 1) ]));
+                for (size_t idx = 1; idx < i; ++idx) {
+                    _array[ wrap(start_idx + idx) ] = std::move(_array[ wrap(start_idx + idx + 1) ]);
+                }
+                _array[ wrap(start_idx + i) ] = std::move(val);
+            }
+        } else if (i == length) {
+            _array.construct(wrap(start_idx + length), std::move(val));
+        } else {
+            // move elements to the right, the new back slot is raw storage
+            _array.construct(wrap(start_idx + length), std::move(_array[ wrap(start_idx + length - 1) ]));
+            for (size_t idx = length - 1; idx > i; --idx) {
+                _array[ wrap(start_idx + idx) ] = std::move(_array[ wrap(start_idx + idx - 1) ]);
+            }
+            _array[ wrap(start_idx + i) ] = std::move(val);
+        }
+
+        ++length;
+    }
+
+    // moves n elements from `first` to the back of the queue.
+    // capacity is reserved once and the elements land in at most two
+    // contiguous runs of the ring
+    template <typename InputIt>
+    void add_n(InputIt first, size_t n) {
+        if (length + n > _array.size()) {
+            resize(grown_capacity(length + n));
+        }
+
+        size_t tail = wrap(start_idx + length);
+        size_t chunk = std::min<size_t>(n, _array.size() - tail);
+        first = std::uninitialized_move_n(first, chunk, _array.data() + tail).first;
+        std::uninitialized_move_n(first, n - chunk, _array.data());
+
+        length += n;
+    }
+
+    // moves up to n elements from the front of the queue to `out`,
+    // returns how many were removed
+    template <typename OutputIt>
+    size_t remove_n(OutputIt out, size_t n) {
+        n = std::min<size_t>(n, length);
+
+        size_t chunk = std::min<size_t>(n, _array.size() - start_idx);
+        T *front = _array.data() + start_idx;
+        out = std::move(front, front + chunk, out);
+        std::destroy(front, front + chunk);
+        std::move(_array.data(), _array.data() + (n - chunk), out);
+        std::destroy(_array.data(), _array.data() + (n - chunk));
+
+        start_idx = wrap(start_idx + n);
+        length -= n;
+        shrink();
+
+        return n;
+    }
+
+    T& get(size_t idx) {
+        return _array[ wrap(start_idx + idx) ];
+    }
+
+    // contiguous run of elements
+    struct span {
+        T *data;
+        size_t size;
+
+        T* begin() const {
+            return data;
+        }
+
+        T* end() const {
+            return data + size;
+        }
+    };
+
+    // the elements in order as at most two contiguous runs of the ring,
+    // the second one is empty unless the ring wraps. valid until the
+    // queue changes; hand them to memcpy or writev, then discard()
+    std::pair<span, span> spans() {
+        size_t first = std::min<size_t>(length, _array.size() - start_idx);
+        return {span{_array.data() + start_idx, first}, span{_array.data(), length - first}};
+    }
+
+    // removes the first n elements without returning them
+    void discard(size_t n) {
+        assert(n <= length);
+
+        size_t chunk = std::min<size_t>(n, _array.size() - start_idx);
+        std::destroy_n(_array.data() + start_idx, chunk);
+        std::destroy_n(_array.data(), n - chunk);
+
+        start_idx = wrap(start_idx + n);
+        length -= n;
+        shrink();
+    }
+
+    bool empty() const {
+        return length == 0;
+    }
+
+    auto size() const {
+        return length;
+    }
+
+    uint32_t capacity() const {
+        return _array.size();
+    }
+
+    T remove() {
+        assert(length != 0);
+
+        T ret(std::move(_array[start_idx]));
+        _array.destroy(start_idx);
+
+        start_idx = wrap(start_idx + 1);
+        --length;
+
+        shrink();
+
+        return ret;
+    }
+
+    template <typename U>
+    void add_front(U&& val) {
+        if (length + 1 > _array.size()) {
+            resize(grown_capacity(length + 1));
+        }
+
+        start_idx = wrap(start_idx + _array.size() - 1);
+        _array.construct(start_idx, std::move(val));
+        ++length;
+    }
+
+    T remove_back() {
+        assert(length != 0);
+
+        auto last = wrap(start_idx + length - 1);
+        T ret(std::move(_array[last]));
+        _array.destroy(last);
+        --length;
+
+        shrink();
+
+        return ret;
+    }
+
+    T remove(size_t i) {
+        assert(i < length);
+
+        T ret(std::move(_array[ wrap(start_idx + i) ]));
+
+        if (i < length / 2) {
+            for (size_t idx = i, count = 0; count < i; --idx, ++count) {
+                _array[ wrap(start_idx + idx) ] = std::move(_array[ wrap(start_idx + idx - 1) ]);
+            }
+            _array.destroy(start_idx);
+            start_idx = wrap(start_idx + 1);
+        } else {
+            for (size_t idx = i; idx < length - 1; ++idx) {
+                _array[ wrap(start_idx + idx) ] = std::move(_array[ wrap(start_idx + idx + 1) ]);
+            }
+            _array.destroy(wrap(start_idx + length - 1));
+        }
+
+        --length;
+
+        shrink();
+
+        return ret;
+    }
+
+    private:
+    size_t wrap(size_t idx) const {
+        if constexpr (PowerOfTwo) {
+            return idx & (_array.size() - 1);
+        } else {
+            return idx % _array.size();
+        }
+    }
+
+    static uint32_t round_capacity(uint32_t capacity) {
+        if constexpr (PowerOfTwo) {
+            return round_up_pow2(capacity);
+        } else {
+            return capacity;
+        }
+    }
+
+    uint32_t grown_capacity(uint32_t required) const {
+        return round_capacity(std::max({4U, required, length + length/2}));
+    }
+
+    void shrink() {
+        if (_array.size() > 3 * length) {
+            uint32_t new_size = std::max(Inline, round_capacity(std::max(4U, length + length/2)));
+            if (new_size != _array.size()) {
+                resize(new_size);
+            }
+        }
+    }
+
+    void resize(uint32_t new_size) {
+        _array.relocate(new_size, [this](T *from, T *to, uint32_t) {
+            for (size_t i = 0; i != length; ++i) {
+                auto j = wrap(start_idx + i);
+                new (to + i) T(std::move(from[j]));
+                from[j].~T();
+            }
+        });
+        start_idx = 0;
+    }
+
+    void clear() {
+        for (size_t i = 0; i != length; ++i) {
+            _array.destroy(wrap(start_idx + i));
+        }
+        length = 0;
+    }
+
+    // after the storage was moved from rhs, brings over the elements that
+    // were still inline in rhs, each to the same slot
+    void take_inline(ArrayQueue& rhs) {
+        if (_array.is_inline()) {
+            for (size_t i = 0; i != length; ++i) {
+                auto j = wrap(start_idx + i);
+                _array.construct(j, std::move(rhs._array[j]));
+                rhs._array.destroy(j);
+            }
+        }
+        rhs.start_idx = 0;
+        rhs.length = 0;
+    }
+};
+
+// keeps independently written fields from sharing a cache line
+constexpr size_t cache_line_size = 64;
+
+// lock-free single-producer/single-consumer ring buffer with fixed capacity.
+// head is written only by the consumer and tail only by the producer, each
+// on its own cache line. every side also keeps a cached copy of the other
+// side's index and only reloads it when the ring looks full or empty, so
+// in steady state the shared lines are not bounced on every call
+template <typename T>
+class SpscArrayQueue {
+    array<T> _array;
+    size_t mask;
+
+    alignas(cache_line_size) std::atomic<size_t> head{0};
+    size_t cached_tail{0};
+
+    alignas(cache_line_size) std::atomic<size_t> tail{0};
+    size_t cached_head{0};
+
+    public:
+    using value_type = T;
+
+    // capacity is rounded up to a power of two
+    SpscArrayQueue(uint32_t capacity): _array(round_up_pow2(capacity)), mask(_array.size() - 1) {}
+
+    SpscArrayQueue(const SpscArrayQueue&) = delete;
+    SpscArrayQueue& operator = (const SpscArrayQueue&) = delete;
+
+    ~SpscArrayQueue() {
+        for (size_t i = head.load(std::memory_order_relaxed), end = tail.load(std::memory_order_relaxed); i != end; ++i) {
+            _array.destroy(i & mask);
+        }
+    }
+
+    uint32_t capacity() const {
+        return _array.size();
+    }
+
+    // approximate when called concurrently
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    // producer side
+    template <typename U>
+    bool try_add(U&& val) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head == _array.size()) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t - cached_head == _array.size()) {
+                return false;
+            }
+        }
+
+        _array.construct(t & mask, std::move(val));
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // producer side, moves up to n elements from `first`, returns how many were added
+    template <typename InputIt>
+    size_t try_add_n(InputIt first, size_t n) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head + n > _array.size()) {
+            cached_head = head.load(std::memory_order_acquire);
+        }
+
+        n = std::min(n, _array.size() - (t - cached_head));
+        size_t idx = t & mask;
+        size_t chunk = std::min<size_t>(n, _array.size() - idx);
+        first = std::uninitialized_move_n(first, chunk, _array.data() + idx).first;
+        std::uninitialized_move_n(first, n - chunk, _array.data());
+
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    // consumer side
+    bool try_remove(T& out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (h == cached_tail) {
+                return false;
+            }
+        }
+
+        out = std::move(_array[h & mask]);
+        _array.destroy(h & mask);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, moves up to n elements to `out`, returns how many were removed
+    template <typename OutputIt>
+    size_t try_remove_n(OutputIt out, size_t n) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (cached_tail - h < n) {
+            cached_tail = tail.load(std::memory_order_acquire);
+        }
+
+        n = std::min(n, cached_tail - h);
+        size_t idx = h & mask;
+        size_t chunk = std::min<size_t>(n, _array.size() - idx);
+        T *front = _array.data() + idx;
+        out = std::move(front, front + chunk, out);
+        std::destroy(front, front + chunk);
+        std::move(_array.data(), _array.data() + (n - chunk), out);
+        std::destroy(_array.data(), _array.data() + (n - chunk));
+
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+};
@@ -0,0 +1,154 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include "avl_map.hpp"
+#include "stat.hpp"
+
+// AVL trees are at most 1.44 log2(n + 2) high
+template <typename Map>
+static void check_height(const Map& map) {
+    assert(double(map.height()) <= 1.4405 * std::log2(double(map.size()) + 2));
+}
+
+// same contents in the same order, both ways
+template <typename Map, typename Model>
+static void check_equal(const Map& map, const Model& model) {
+    assert(map.size() == model.size());
+    assert(size_t(std::distance(map.begin(), map.end())) == model.size());
+    assert(std::equal(map.begin(), map.end(), model.begin(), model.end()));
+    assert(std::equal(std::make_reverse_iterator(map.end()), std::make_reverse_iterator(map.begin()),
+                      model.rbegin(), model.rend()));
+}
+
+// random insert/erase/lookup mix checked against std::map
+void test_avl_map_random(size_t count) {
+    avl_map<int, int> map;
+    std::map<int, int> model;
+    std::mt19937 rng(7);
+
+    for (size_t i = 0; i != count; ++i) {
+        int key = int(rng() % (count / 4));
+        switch (rng() % 4) {
+            case 0:
+            case 1:
+                assert(map.insert(key, int(i)) == model.emplace(key, int(i)).second);
+                break;
+            case 2:
+                assert(map.erase(key) == (model.erase(key) == 1));
+                break;
+            case 3: {
+                auto it = map.lower_bound(key);
+                auto expected = model.lower_bound(key);
+                assert((it == map.end()) == (expected == model.end()));
+                if (it != map.end()) {
+                    assert(*it == *expected);
+                }
+                assert(map.contains(key) == (model.count(key) == 1));
+                break;
+            }
+        }
+
+        if (i % 1000 == 0) {
+            check_equal(map, model);
+            check_height(map);
+        }
+    }
+    check_equal(map, model);
+
+    // erase a range through iterators
+    auto it = map.lower_bound(int(count / 16));
+    while (it != map.end() && it->first < int(count / 8)) {
+        it = map.erase(it);
+    }
+    model.erase(model.lower_bound(int(count / 16)), model.lower_bound(int(count / 8)));
+    check_equal(map, model);
+    check_height(map);
+
+    std::cout << "test_avl_map_random > size: " << map.size() << " height: " << map.height() << std::endl;
+}
+
+// sorted and zig-zag inserts are the worst case for an unbalanced tree
+void test_avl_map_orders() {
+    const int n = 100000;
+
+    avl_map<int, int> ascending;
+    avl_map<int, int, std::greater<int>> descending;
+    for (int i = 0; i != n; ++i) {
+        ascending[i] = i;
+        descending[i] = i;
+    }
+    check_height(ascending);
+    check_height(descending);
+    assert(ascending.begin()->first == 0);
+    assert(descending.begin()->first == n - 1);
+    assert(descending.lower_bound(n / 2)->first == n / 2);
+    assert(descending.upper_bound(n / 2)->first == n / 2 - 1);
+
+    avl_map<int, int> zigzag;
+    for (int i = 0; i != n / 2; ++i) {
+        zigzag[i] = i;
+        zigzag[n - 1 - i] = i;
+    }
+    check_height(zigzag);
+
+    int expected = 0;
+    for (auto& [key, value] : zigzag) {
+        assert(key == expected++);
+    }
+
+    for (int i = 0; i != n; i += 2) {
+        assert(ascending.erase(i));
+    }
+    check_height(ascending);
+    assert(ascending.size() == n / 2);
+
+    std::cout << "test_avl_map_orders > height: " << zigzag.height() << std::endl;
+}
+
+void test_avl_map_values() {
+    {
+        avl_map<std::string, cnt<0>> map;
+        for (size_t i = 0; i != 1000; ++i) {
+            assert(map.insert(std::to_string(i), cnt<0>{i}));
+        }
+        assert(!map.insert("7", cnt<0>{0}));
+        assert(map.find("7")->second.value == 7);
+        assert(map.find("1000") == map.end());
+
+        uint32_t before = cnt<0>::constructed + cnt<0>::moved + cnt<0>::copied;
+        map["1000"].value = 1000;
+        assert(map.size() == 1001);
+        assert(map.find("1000")->second.value == 1000);
+        assert(cnt<0>::constructed + cnt<0>::moved + cnt<0>::copied == before + 1);
+
+        // a hit builds no value at all
+        before = cnt<0>::constructed + cnt<0>::moved + cnt<0>::copied;
+        assert(map["7"].value == 7 && map["1000"].value == 1000);
+        assert(cnt<0>::constructed + cnt<0>::moved + cnt<0>::copied == before);
+
+        for (size_t i = 0; i != 1000; i += 2) {
+            assert(map.erase(std::to_string(i)));
+        }
+
+        size_t sum = 0;
+        for (auto& [key, value] : map) {
+            sum += value.value;
+        }
+        assert(sum == 250000 + 1000);
+
+        std::cout << "test_avl_map_values > " << cnt<0>{} << std::endl;
+    }
+    assert(cnt<0>::constructed + cnt<0>::moved + cnt<0>::copied == cnt<0>::destroyed);
+}
+
+void _main() {
+    std::cout << "avl map test" << std::endl;
+    test_avl_map_random(200000);
+    test_avl_map_orders();
+    test_avl_map_values();
+}
@@ -0,0 +1,463 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "linked_tree.hpp"
+#include "pool.hpp"
+
+// ordered map on parent-linked tree nodes, kept AVL balanced: the heights
+// of the two subtrees of any node differ by at most one, so the height is
+// below 1.44 log2(n) and insert, find, erase and lower_bound are O(log n).
+// iteration walks the parent links (see linked_tree.hpp), so it needs no
+// stack and incrementing an iterator is amortized O(1)
+template <typename K, typename V, typename Compare = std::less<K>,
+          typename Allocator = PoolAllocator<std::pair<const K, V>>>
+class avl_map {
+    public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const K, V>;
+    using key_compare = Compare;
+
+    private:
+    struct Node : linked_tree_node<value_type> {
+        int32_t height{1};
+
+        template <typename... Args>
+        Node(Args&&... args): linked_tree_node<value_type>(std::in_place, std::forward<Args>(args)...) {}
+    };
+
+    using base_node = linked_tree_node<value_type>;
+
+    using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_traits = std::allocator_traits<node_allocator>;
+
+    Node *root{nullptr};
+    size_t length{0};
+    Compare less;
+    node_allocator alloc;
+
+    template <bool Const>
+    class basic_iterator {
+        friend class avl_map;
+        template <bool> friend class basic_iterator;
+        using map_type = std::conditional_t<Const, const avl_map, avl_map>;
+
+        Node *curr{nullptr};
+        map_type *map{nullptr};
+
+        basic_iterator(Node *curr, map_type *map): curr(curr), map(map) {}
+
+        public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = avl_map::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+        basic_iterator() {}
+
+        operator basic_iterator<true>() const {
+            return basic_iterator<true>(curr, map);
+        }
+
+        reference operator * () const {
+            return curr->value;
+        }
+
+        pointer operator -> () const {
+            return &curr->value;
+        }
+
+        basic_iterator& operator ++ () {
+            curr = static_cast<Node *>(next_in_order<tree_order::inorder>(static_cast<base_node *>(curr)));
+            return *this;
+        }
+
+        basic_iterator operator ++ (int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        // the root moves with rotations, so --end() asks the map for it
+        basic_iterator& operator -- () {
+            base_node *node = curr != nullptr
+                ? prev_in_order<tree_order::inorder>(static_cast<base_node *>(curr))
+                : last_in_order<tree_order::inorder>(static_cast<base_node *>(map->root));
+            curr = static_cast<Node *>(node);
+            return *this;
+        }
+
+        basic_iterator operator -- (int) {
+            auto copy = *this;
+            --*this;
+            return copy;
+        }
+
+        bool operator == (const basic_iterator& rhs) const {
+            return curr == rhs.curr;
+        }
+
+        bool operator != (const basic_iterator& rhs) const {
+            return curr != rhs.curr;
+        }
+    };
+
+    public:
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+    using allocator_type = node_allocator;
+
+    avl_map() {}
+
+    explicit avl_map(Compare less): less(std::move(less)) {}
+
+    avl_map(const avl_map&) = delete;
+    avl_map& operator = (const avl_map&) = delete;
+
+    avl_map(avl_map&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    avl_map& operator = (avl_map&& rhs) noexcept {
+        clear();
+        alloc = std::move(rhs.alloc);
+        less = std::move(rhs.less);
+        root = rhs.root;
+        length = rhs.length;
+        rhs.root = nullptr;
+        rhs.length = 0;
+        return *this;
+    }
+
+    ~avl_map() {
+        clear();
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    bool empty() const {
+        return length == 0;
+    }
+
+    const allocator_type& get_allocator() const {
+        return alloc;
+    }
+
+    // height of the tree, 0 when empty
+    size_t height() const {
+        return height(root);
+    }
+
+    void clear() {
+        // a pooled map of trivially destructible entries is dropped slab by slab
+        if constexpr (!is_bulk_release_v<node_allocator> || !std::is_trivially_destructible_v<value_type>) {
+            Node *node = first_postorder(root);
+            while (node != nullptr) {
+                Node *next = static_cast<Node *>(next_in_order<tree_order::postorder>(static_cast<base_node *>(node)));
+                destroy_node(node);
+                node = next;
+            }
+        }
+
+        if constexpr (is_bulk_release_v<node_allocator>) {
+            alloc.release();
+        }
+
+        root = nullptr;
+        length = 0;
+    }
+
+    iterator begin() {
+        return iterator(leftmost(root), this);
+    }
+
+    iterator end() {
+        return iterator(nullptr, this);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(leftmost(root), this);
+    }
+
+    const_iterator end() const {
+        return const_iterator(nullptr, this);
+    }
+
+    // returns false and leaves the map untouched if the key is present
+    template <typename U>
+    bool insert(const K& key, U&& value) {
+        return emplace(key, std::forward<U>(value)).second;
+    }
+
+    template <typename U>
+    std::pair<iterator, bool> emplace(const K& key, U&& value) {
+        return emplace_node(key, key, std::forward<U>(value));
+    }
+
+    // the mapped value is default-constructed in the new node, a hit builds none
+    V& operator [] (const K& key) {
+        return emplace_node(key, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple()).first->second;
+    }
+
+    iterator find(const K& key) {
+        return iterator(find_node(key), this);
+    }
+
+    const_iterator find(const K& key) const {
+        return const_iterator(find_node(key), this);
+    }
+
+    bool contains(const K& key) const {
+        return find_node(key) != nullptr;
+    }
+
+    // first entry whose key is not less than key
+    iterator lower_bound(const K& key) {
+        return iterator(bound(key, false), this);
+    }
+
+    const_iterator lower_bound(const K& key) const {
+        return const_iterator(bound(key, false), this);
+    }
+
+    // first entry whose key is greater than key
+    iterator upper_bound(const K& key) {
+        return iterator(bound(key, true), this);
+    }
+
+    const_iterator upper_bound(const K& key) const {
+        return const_iterator(bound(key, true), this);
+    }
+
+    bool erase(const K& key) {
+        Node *node = find_node(key);
+        if (node == nullptr) {
+            return false;
+        }
+        erase_node(node);
+        return true;
+    }
+
+    // returns the iterator following the erased entry
+    iterator erase(const_iterator pos) {
+        assert(pos.curr != nullptr);
+        iterator next(pos.curr, this);
+        ++next;
+        erase_node(pos.curr);
+        return next;
+    }
+
+    private:
+    static Node* left_of(const base_node *node) {
+        return static_cast<Node *>(node->left);
+    }
+
+    static Node* right_of(const base_node *node) {
+        return static_cast<Node *>(node->right);
+    }
+
+    static Node* parent_of(const base_node *node) {
+        return static_cast<Node *>(node->parent);
+    }
+
+    static int32_t height(Node *node) {
+        return node != nullptr ? node->height : 0;
+    }
+
+    static void update(Node *node) {
+        node->height = 1 + std::max(height(left_of(node)), height(right_of(node)));
+    }
+
+    static Node* leftmost(Node *node) {
+        if (node != nullptr) {
+            while (left_of(node) != nullptr) {
+                node = left_of(node);
+            }
+        }
+        return node;
+    }
+
+    static Node* first_postorder(Node *node) {
+        return static_cast<Node *>(first_in_order<tree_order::postorder>(static_cast<base_node *>(node)));
+    }
+
+    // finds key or links a new node built from args in its place
+    template <typename... Args>
+    std::pair<iterator, bool> emplace_node(const K& key, Args&&... args) {
+        Node *parent = nullptr;
+        bool left = false;
+
+        for (Node *node = root; node != nullptr; ) {
+            parent = node;
+            if (less(key, node->value.first)) {
+                left = true;
+                node = left_of(node);
+            } else if (less(node->value.first, key)) {
+                left = false;
+                node = right_of(node);
+            } else {
+                return {iterator(node, this), false};
+            }
+        }
+
+        Node *node = node_traits::allocate(alloc, 1);
+        node_traits::construct(alloc, node, std::forward<Args>(args)...);
+        node->parent = parent;
+        if (parent == nullptr) {
+            root = node;
+        } else if (left) {
+            parent->left = node;
+        } else {
+            parent->right = node;
+        }
+
+        ++length;
+        rebalance_up(parent);
+        return {iterator(node, this), true};
+    }
+
+    Node* find_node(const K& key) const {
+        Node *node = root;
+        while (node != nullptr) {
+            if (less(key, node->value.first)) {
+                node = left_of(node);
+            } else if (less(node->value.first, key)) {
+                node = right_of(node);
+            } else {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    Node* bound(const K& key, bool upper) const {
+        Node *found = nullptr;
+        Node *node = root;
+        while (node != nullptr) {
+            bool go_right = upper ? !less(key, node->value.first) : less(node->value.first, key);
+            if (go_right) {
+                node = right_of(node);
+            } else {
+                found = node;
+                node = left_of(node);
+            }
+        }
+        return found;
+    }
+
+    void replace_child(Node *parent, Node *old_child, Node *new_child) {
+        if (parent == nullptr) {
+            root = new_child;
+        } else if (parent->left == old_child) {
+            parent->left = new_child;
+        } else {
+            parent->right = new_child;
+        }
+        if (new_child != nullptr) {
+            new_child->parent = parent;
+        }
+    }
+
+    Node* rotate_left(Node *x) {
+        Node *y = right_of(x);
+        x->right = y->left;
+        if (y->left != nullptr) {
+            y->left->parent = x;
+        }
+        replace_child(parent_of(x), x, y);
+        y->left = x;
+        x->parent = y;
+        update(x);
+        update(y);
+        return y;
+    }
+
+    Node* rotate_right(Node *x) {
+        Node *y = left_of(x);
+        x->left = y->right;
+        if (y->right != nullptr) {
+            y->right->parent = x;
+        }
+        replace_child(parent_of(x), x, y);
+        y->right = x;
+        x->parent = y;
+        update(x);
+        update(y);
+        return y;
+    }
+
+    // restores the balance of a node whose subtrees were just changed
+    // and returns the root of that subtree
+    Node* rebalance(Node *node) {
+        int32_t balance = height(left_of(node)) - height(right_of(node));
+        if (balance > 1) {
+            if (height(left_of(left_of(node))) < height(right_of(left_of(node)))) {
+                rotate_left(left_of(node));
+            }
+            return rotate_right(node);
+        }
+        if (balance < -1) {
+            if (height(right_of(right_of(node))) < height(left_of(right_of(node)))) {
+                rotate_right(right_of(node));
+            }
+            return rotate_left(node);
+        }
+        update(node);
+        return node;
+    }
+
+    // walks to the root, at most one rebalance per level
+    void rebalance_up(Node *node) {
+        while (node != nullptr) {
+            node = parent_of(rebalance(node));
+        }
+    }
+
+    void erase_node(Node *node) {
+        Node *start;
+
+        if (node->left != nullptr && node->right != nullptr) {
+            // move the successor into the erased node's place: keys are
+            // const, so nodes are relinked rather than values swapped
+            Node *next = leftmost(right_of(node));
+            Node *next_parent = parent_of(next);
+            replace_child(next_parent, next, right_of(next));
+            start = next_parent == node ? next : next_parent;
+
+            next->left = node->left;
+            next->right = node->right;
+            if (next->left != nullptr) {
+                next->left->parent = next;
+            }
+            if (next->right != nullptr) {
+                next->right->parent = next;
+            }
+            next->height = node->height;
+            replace_child(parent_of(node), node, next);
+        } else {
+            start = parent_of(node);
+            replace_child(start, node, node->left != nullptr ? left_of(node) : right_of(node));
+        }
+
+        destroy_node(node);
+        --length;
+        rebalance_up(start);
+    }
+
+    void destroy_node(Node *node) {
+        node_traits::destroy(alloc, node);
+        node_traits::deallocate(alloc, node, 1);
+    }
+};
@@ -0,0 +1,1194 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <forward_list>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "array.hpp"
+#include "arena_tree.hpp"
+#include "avl_map.hpp"
+#include "bench.hpp"
+#include "bplus_tree.hpp"
+#include "flat_tree.hpp"
+#include "hash.hpp"
+#include "heap.hpp"
+#include "linked_tree.hpp"
+#include "list.hpp"
+#include "mapped_array.hpp"
+#include "parallel.hpp"
+#include "skip_list.hpp"
+#include "static_array.hpp"
+#include "tree.hpp"
+
+template <typename Stack>
+static void stack_push_back(bench_runner& runner, const char *name, size_t n) {
+    runner.run("push_back", name, n, n, [n] {
+        Stack stack;
+        for (size_t i = 0; i != n; ++i) {
+            stack.add(stack.size(), uint64_t(i));
+        }
+        do_not_optimize(stack.get(n - 1));
+    });
+}
+
+template <typename Std>
+static void std_push_back(bench_runner& runner, const char *name, size_t n) {
+    runner.run("push_back", name, n, n, [n] {
+        Std container;
+        for (size_t i = 0; i != n; ++i) {
+            container.push_back(uint64_t(i));
+        }
+        do_not_optimize(container.back());
+    });
+}
+
+static std::string mapped_path() {
+    return "/tmp/ds_playground_bench." + std::to_string(::getpid());
+}
+
+static void mapped_push_back(bench_runner& runner, size_t n) {
+    std::string path = mapped_path();
+    runner.run("push_back", "MappedArrayStack", n, n, [n, &path] {
+        ::unlink(path.c_str());
+        MappedArrayStack<uint64_t> stack(path);
+        for (size_t i = 0; i != n; ++i) {
+            stack.add(stack.size(), uint64_t(i));
+        }
+        do_not_optimize(stack.get(n - 1));
+    });
+    ::unlink(path.c_str());
+}
+
+static void bench_push_back(bench_runner& runner, size_t n) {
+    stack_push_back<ArrayStack<uint64_t>>(runner, "ArrayStack", n);
+    stack_push_back<FastArrayStack<uint64_t>>(runner, "FastArrayStack", n);
+    stack_push_back<TieredArrayStack<uint64_t>>(runner, "TieredArrayStack", n);
+    std_push_back<std::vector<uint64_t>>(runner, "std::vector", n);
+    std_push_back<std::deque<uint64_t>>(runner, "std::deque", n);
+    mapped_push_back(runner, n);
+}
+
+// gets an n element stack back after a restart: the mapped one is
+// reopened, the heap one rebuilt from its elements
+static void bench_reopen(bench_runner& runner, size_t n) {
+    if (runner.enabled("reopen", "MappedArrayStack")) {
+        std::string path = mapped_path();
+        ::unlink(path.c_str());
+        {
+            MappedArrayStack<uint64_t> stack(path);
+            stack.reserve(uint32_t(n));
+            for (size_t i = 0; i != n; ++i) {
+                stack.add(i, uint64_t(i));
+            }
+        }
+
+        runner.run("reopen", "MappedArrayStack", n, n, [n, &path] {
+            MappedArrayStack<uint64_t> stack(path);
+            do_not_optimize(stack.get(n - 1));
+        });
+        ::unlink(path.c_str());
+    }
+
+    runner.run("reopen", "FastArrayStack rebuild", n, n, [n] {
+        FastArrayStack<uint64_t> stack;
+        stack.reserve(uint32_t(n));
+        for (size_t i = 0; i != n; ++i) {
+            stack.add(i, uint64_t(i));
+        }
+        do_not_optimize(stack.get(n - 1));
+    });
+}
+
+// add and remove at random positions of an n element stack
+template <typename Stack>
+static void positional_edit(bench_runner& runner, const char *name, size_t n, const std::vector<uint32_t>& positions) {
+    if (!runner.enabled("positional_edit", name)) {
+        return;
+    }
+
+    Stack stack;
+    for (size_t i = 0; i != n; ++i) {
+        stack.add(stack.size(), uint64_t(i));
+    }
+    runner.run("positional_edit", name, n, 2 * positions.size(), [&] {
+        for (uint32_t idx : positions) {
+            stack.add(idx, uint64_t(idx));
+            do_not_optimize(stack.remove(idx));
+        }
+    });
+}
+
+static void std_positional_edit(bench_runner& runner, size_t n, const std::vector<uint32_t>& positions) {
+    if (!runner.enabled("positional_edit", "std::vector")) {
+        return;
+    }
+
+    std::vector<uint64_t> vector(n);
+    runner.run("positional_edit", "std::vector", n, 2 * positions.size(), [&] {
+        for (uint32_t idx : positions) {
+            vector.insert(vector.begin() + idx, uint64_t(idx));
+            do_not_optimize(vector[idx]);
+            vector.erase(vector.begin() + idx);
+        }
+    });
+}
+
+static void bench_positional_edit(bench_runner& runner, size_t n) {
+    std::mt19937 rng(9);
+    std::vector<uint32_t> positions(std::min<size_t>(n, 256));
+    for (auto& idx : positions) {
+        idx = uint32_t(rng() % n);
+    }
+
+    positional_edit<ArrayStack<uint64_t>>(runner, "ArrayStack", n, positions);
+    positional_edit<FastArrayStack<uint64_t>>(runner, "FastArrayStack", n, positions);
+    positional_edit<TieredArrayStack<uint64_t>>(runner, "TieredArrayStack", n, positions);
+    std_positional_edit(runner, n, positions);
+}
+
+// builds, reads and drops a container of n elements, the lifetime of
+// most containers in practice
+template <typename Container, typename Add>
+static void short_lived(bench_runner& runner, const char *name, size_t n, Add add) {
+    runner.run("short_lived", name, n, n, [n, add] {
+        Container container;
+        for (size_t i = 0; i != n; ++i) {
+            add(container, uint64_t(i));
+        }
+        uint64_t sum = 0;
+        for (size_t i = 0; i != n; ++i) {
+            sum += container[i];
+        }
+        do_not_optimize(sum);
+    });
+}
+
+template <typename Container>
+struct indexed : Container {
+    uint64_t& operator [] (size_t idx) {
+        return this->get(idx);
+    }
+};
+
+static void bench_short_lived(bench_runner& runner) {
+    auto stack_add = [](auto& stack, uint64_t v) { stack.add(stack.size(), v); };
+    auto queue_add = [](auto& queue, uint64_t v) { queue.add(v); };
+    auto vector_add = [](auto& vector, uint64_t v) { vector.push_back(v); };
+
+    for (size_t n : {4, 8, 16}) {
+        short_lived<indexed<ArrayStack<uint64_t>>>(runner, "ArrayStack", n, stack_add);
+        short_lived<indexed<ArrayStack<uint64_t, geometric_growth<>, 16>>>(runner, "ArrayStack<inline 16>", n, stack_add);
+        short_lived<indexed<ArrayQueue<uint64_t, true>>>(runner, "ArrayQueue<pow2>", n, queue_add);
+        short_lived<indexed<ArrayQueue<uint64_t, true, 16>>>(runner, "ArrayQueue<pow2, inline 16>", n, queue_add);
+        short_lived<indexed<StaticArrayStack<uint64_t, 16>>>(runner, "StaticArrayStack<16>", n, stack_add);
+        short_lived<indexed<StaticArrayQueue<uint64_t, 16>>>(runner, "StaticArrayQueue<16>", n, queue_add);
+        short_lived<std::vector<uint64_t>>(runner, "std::vector", n, vector_add);
+    }
+}
+
+// fills a FIFO with n elements and drains it, 2n operations
+template <typename Queue>
+static void queue_churn(bench_runner& runner, const char *name, size_t n) {
+    runner.run("queue_churn", name, n, 2 * n, [n] {
+        Queue queue;
+        for (size_t i = 0; i != n; ++i) {
+            queue.add(uint64_t(i));
+        }
+        uint64_t sum = 0;
+        for (size_t i = 0; i != n; ++i) {
+            sum += queue.remove();
+        }
+        do_not_optimize(sum);
+    });
+}
+
+template <typename Std>
+static void std_queue_churn(bench_runner& runner, const char *name, size_t n) {
+    runner.run("queue_churn", name, n, 2 * n, [n] {
+        Std queue;
+        for (size_t i = 0; i != n; ++i) {
+            queue.push_back(uint64_t(i));
+        }
+        uint64_t sum = 0;
+        for (size_t i = 0; i != n; ++i) {
+            sum += queue.front();
+            queue.pop_front();
+        }
+        do_not_optimize(sum);
+    });
+}
+
+static void forward_list_churn(bench_runner& runner, size_t n) {
+    runner.run("queue_churn", "std::forward_list", n, 2 * n, [n] {
+        std::forward_list<uint64_t> queue;
+        auto tail = queue.before_begin();
+        for (size_t i = 0; i != n; ++i) {
+            tail = queue.insert_after(tail, uint64_t(i));
+        }
+        uint64_t sum = 0;
+        for (size_t i = 0; i != n; ++i) {
+            sum += queue.front();
+            queue.pop_front();
+        }
+        do_not_optimize(sum);
+    });
+}
+
+static void bench_queue_churn(bench_runner& runner, size_t n) {
+    queue_churn<ArrayQueue<uint64_t>>(runner, "ArrayQueue", n);
+    queue_churn<ArrayQueue<uint64_t, true>>(runner, "ArrayQueue<pow2>", n);
+    queue_churn<SinglyLinkedList<uint64_t>>(runner, "SinglyLinkedList<pool>", n);
+    queue_churn<SinglyLinkedList<uint64_t, std::allocator<uint64_t>>>(runner, "SinglyLinkedList<std::allocator>", n);
+    queue_churn<UnrolledLinkedList<uint64_t>>(runner, "UnrolledLinkedList<pool>", n);
+    queue_churn<UnrolledLinkedList<uint64_t, std::allocator<uint64_t>>>(runner, "UnrolledLinkedList<std::allocator>", n);
+    std_queue_churn<std::deque<uint64_t>>(runner, "std::deque", n);
+    std_queue_churn<std::list<uint64_t>>(runner, "std::list", n);
+    forward_list_churn(runner, n);
+}
+
+// copies a wrapped ring of n elements into a flat buffer
+template <typename Queue>
+static void queue_copy_out(bench_runner& runner, const std::string& name, size_t n) {
+    if (!runner.any_enabled("copy_out", {name + " get", name + " spans"})) {
+        return;
+    }
+
+    Queue queue;
+    for (size_t i = 0; i != n; ++i) {
+        queue.add(uint64_t(i));
+    }
+    // move the start to the middle of the ring so the contents wrap
+    for (size_t i = 0; i != n / 2; ++i) {
+        queue.add(queue.remove());
+    }
+    std::vector<uint64_t> out(n);
+
+    runner.run("copy_out", name + " get", n, n, [&] {
+        for (size_t i = 0; i != n; ++i) {
+            out[i] = queue.get(i);
+        }
+        do_not_optimize(out.data());
+    });
+    runner.run("copy_out", name + " spans", n, n, [&] {
+        auto [first, second] = queue.spans();
+        std::memcpy(out.data(), first.data, first.size * sizeof(uint64_t));
+        std::memcpy(out.data() + first.size, second.data, second.size * sizeof(uint64_t));
+        do_not_optimize(out.data());
+    });
+}
+
+static void bench_copy_out(bench_runner& runner, size_t n) {
+    queue_copy_out<ArrayQueue<uint64_t>>(runner, "ArrayQueue", n);
+    queue_copy_out<ArrayQueue<uint64_t, true>>(runner, "ArrayQueue<pow2>", n);
+}
+
+// indexed read of every element of a container filled by fill
+template <typename Container, typename Fill>
+static void indexed_scan(bench_runner& runner, const char *name, size_t n, Fill fill) {
+    if (!runner.enabled("scan", name)) {
+        return;
+    }
+
+    Container container;
+    fill(container);
+    runner.run("scan", name, n, n, [&container, n] {
+        uint64_t sum = 0;
+        for (size_t i = 0; i != n; ++i) {
+            sum += container.get(i);
+        }
+        do_not_optimize(sum);
+    });
+}
+
+template <typename Std, typename Fill>
+static void std_scan(bench_runner& runner, const char *name, size_t n, Fill fill) {
+    if (!runner.enabled("scan", name)) {
+        return;
+    }
+
+    Std container;
+    fill(container);
+    runner.run("scan", name, n, n, [&container] {
+        uint64_t sum = 0;
+        for (auto v : container) {
+            sum += v;
+        }
+        do_not_optimize(sum);
+    });
+}
+
+static void bench_scan(bench_runner& runner, size_t n) {
+    auto stack_fill = [n](auto& stack) {
+        for (size_t i = 0; i != n; ++i) {
+            stack.add(i, uint64_t(i));
+        }
+    };
+    auto queue_fill = [n](auto& queue) {
+        for (size_t i = 0; i != n; ++i) {
+            queue.add(uint64_t(i));
+        }
+    };
+    auto std_fill = [n](auto& container) { container.assign(n, 1); };
+
+    indexed_scan<ArrayStack<uint64_t>>(runner, "ArrayStack", n, stack_fill);
+    indexed_scan<FastArrayStack<uint64_t>>(runner, "FastArrayStack", n, stack_fill);
+    indexed_scan<ArrayQueue<uint64_t>>(runner, "ArrayQueue", n, queue_fill);
+    indexed_scan<ArrayQueue<uint64_t, true>>(runner, "ArrayQueue<pow2>", n, queue_fill);
+    std_scan<SinglyLinkedList<uint64_t>>(runner, "SinglyLinkedList", n, queue_fill);
+    std_scan<UnrolledLinkedList<uint64_t>>(runner, "UnrolledLinkedList", n, queue_fill);
+    std_scan<std::vector<uint64_t>>(runner, "std::vector", n, std_fill);
+    std_scan<std::deque<uint64_t>>(runner, "std::deque", n, std_fill);
+    std_scan<std::list<uint64_t>>(runner, "std::list", n, std_fill);
+    std_scan<std::forward_list<uint64_t>>(runner, "std::forward_list", n, std_fill);
+}
+
+struct bench_item : IntrusiveListHook<> {
+    uint64_t key;
+    uint64_t seq;
+};
+
+// n elements handed from 64-element producer batches to a consumer and
+// back, n operations each way
+static void bench_handoff(bench_runner& runner, size_t n) {
+    const size_t batch = 64;
+    const size_t batches = (n + batch - 1) / batch;
+
+    if (runner.enabled("handoff", "IntrusiveList splice")) {
+        std::vector<bench_item> items(n);
+        std::vector<IntrusiveList<bench_item>> producers(batches);
+        for (size_t i = 0; i != n; ++i) {
+            producers[i / batch].add(items[i]);
+        }
+        runner.run("handoff", "IntrusiveList splice", n, 2 * n, [&] {
+            IntrusiveList<bench_item> consumer;
+            for (auto& producer : producers) {
+                consumer.splice(producer);
+            }
+            for (auto& producer : producers) {
+                for (size_t i = 0; i != batch && !consumer.empty(); ++i) {
+                    producer.add(consumer.remove());
+                }
+            }
+        });
+    }
+
+    if (runner.enabled("handoff", "SinglyLinkedList<pool>")) {
+        std::vector<SinglyLinkedList<uint64_t>> lists(batches);
+        for (size_t i = 0; i != n; ++i) {
+            lists[i / batch].add(uint64_t(i));
+        }
+        runner.run("handoff", "SinglyLinkedList<pool>", n, 2 * n, [&] {
+            SinglyLinkedList<uint64_t> consumer;
+            for (auto& producer : lists) {
+                while (!producer.empty()) {
+                    consumer.add(producer.remove());
+                }
+            }
+            for (auto& producer : lists) {
+                for (size_t i = 0; i != batch && !consumer.empty(); ++i) {
+                    producer.add(consumer.remove());
+                }
+            }
+        });
+    }
+}
+
+// sorts n elements by a random key and back into place, 2 sorts per run
+static void bench_list_sort(bench_runner& runner, size_t n) {
+    if (!runner.any_enabled("list_sort", {"IntrusiveList", "std::list", "std::forward_list"})) {
+        return;
+    }
+
+    std::mt19937_64 rng(5);
+    std::vector<bench_item> items(n);
+    IntrusiveList<bench_item> intrusive;
+    std::list<std::pair<uint64_t, uint64_t>> list;
+    std::forward_list<std::pair<uint64_t, uint64_t>> forward_list;
+    for (size_t i = n; i-- != 0; ) {
+        items[i].key = rng();
+        items[i].seq = i;
+        forward_list.emplace_front(items[i].key, i);
+    }
+    for (auto& item : items) {
+        intrusive.add(item);
+        list.emplace_back(item.key, item.seq);
+    }
+
+    auto by_key = [](const auto& a, const auto& b) { return a.first < b.first; };
+    auto by_seq = [](const auto& a, const auto& b) { return a.second < b.second; };
+
+    runner.run("list_sort", "IntrusiveList", n, 2 * n, [&] {
+        intrusive.sort([](const bench_item& a, const bench_item& b) { return a.key < b.key; });
+        intrusive.sort([](const bench_item& a, const bench_item& b) { return a.seq < b.seq; });
+    });
+    runner.run("list_sort", "std::list", n, 2 * n, [&] {
+        list.sort(by_key);
+        list.sort(by_seq);
+    });
+    runner.run("list_sort", "std::forward_list", n, 2 * n, [&] {
+        forward_list.sort(by_key);
+        forward_list.sort(by_seq);
+    });
+}
+
+// insert, find and erase of n random keys
+template <typename Set, typename Insert, typename Contains>
+static void hash_ops(bench_runner& runner, const std::string& name, const std::vector<uint64_t>& keys,
+                     Insert insert, Contains contains) {
+    size_t n = keys.size();
+    runner.run("hash_insert", name, n, n, [&] {
+        Set set;
+        for (auto key : keys) {
+            insert(set, key);
+        }
+        do_not_optimize(set.size());
+    });
+
+    if (runner.enabled("hash_find", name)) {
+        Set full;
+        for (auto key : keys) {
+            insert(full, key);
+        }
+        runner.run("hash_find", name, n, n, [&] {
+            size_t found = 0;
+            for (auto key : keys) {
+                found += contains(full, key);
+            }
+            do_not_optimize(found);
+        });
+    }
+
+    // erasing needs a fresh table each time, its fill is timed as well
+    runner.run("hash_insert_erase", name, n, 2 * n, [&] {
+        Set set;
+        for (auto key : keys) {
+            insert(set, key);
+        }
+        for (auto key : keys) {
+            set.erase(key);
+        }
+        do_not_optimize(set.size());
+    });
+}
+
+static void bench_hash(bench_runner& runner, size_t n) {
+    if (!runner.enabled("hash_insert") && !runner.enabled("hash_find") && !runner.enabled("hash_insert_erase")) {
+        return;
+    }
+
+    std::mt19937_64 rng(n);
+    std::vector<uint64_t> keys(n);
+    for (auto& key : keys) {
+        key = rng();
+    }
+
+    auto insert = [](auto& set, uint64_t key) { set.insert(key); };
+    hash_ops<flat_hash_set<uint64_t>>(runner, "flat_hash_set", keys, insert,
+                                      [](auto& set, uint64_t key) { return set.contains(key); });
+    hash_ops<std::unordered_set<uint64_t>>(runner, "std::unordered_set", keys, insert,
+                                           [](auto& set, uint64_t key) { return set.count(key) != 0; });
+}
+
+// balanced tree over values [lo, hi)
+static tree_node<int>* build_tree(int lo, int hi) {
+    if (lo >= hi) {
+        return nullptr;
+    }
+
+    int mid = lo + (hi - lo) / 2;
+    return new tree_node<int>(mid, build_tree(lo, mid), build_tree(mid + 1, hi));
+}
+
+static void bench_traversal(bench_runner& runner, size_t n) {
+    if (!runner.enabled("traversal")) {
+        return;
+    }
+
+    auto *root = build_tree(0, int(n));
+    int64_t sum = 0;
+
+    // every traversal runs with an inlinable lambda and with the type-erased visitor
+    auto traverse = [&](const std::string& name, auto traversal) {
+        runner.run("traversal", name, n, n, [&] {
+            sum = 0;
+            traversal(root, [&sum](tree_node<int> *node) { sum += node->value; });
+            do_not_optimize(sum);
+        });
+
+        visitor<int> erased = [&sum](tree_node<int> *node) { sum += node->value; };
+        runner.run("traversal", name + "<std::function>", n, n, [&] {
+            sum = 0;
+            traversal(root, erased);
+            do_not_optimize(sum);
+        });
+    };
+
+    traverse("recursive_preorder", [](auto *root, auto&& f) { return recursive_preorder(root, f); });
+    traverse("recursive_inorder", [](auto *root, auto&& f) { return recursive_inorder(root, f); });
+    traverse("recursive_postorder", [](auto *root, auto&& f) { return recursive_postorder(root, f); });
+    traverse("iterative_preorder", [](auto *root, auto&& f) { return iterative_preorder(root, f); });
+    traverse("iterative_inorder_with_marking", [](auto *root, auto&& f) { return iterative_inorder_with_marking(root, f); });
+    traverse("iterative_inorder", [](auto *root, auto&& f) { return iterative_inorder(root, f); });
+    traverse("morris_inorder", [](auto *root, auto&& f) { return morris_inorder(root, f); });
+    traverse("iterative_postorder", [](auto *root, auto&& f) { return iterative_postorder(root, f); });
+
+    // the same tree in one buffer with 32-bit links
+    if (runner.any_enabled("traversal", {"arena_tree recursive_inorder", "arena_tree iterative_inorder",
+                                         "arena_tree iterative_inorder_with_marking", "arena_tree morris_inorder",
+                                         "arena_tree for_each"})) {
+        arena_tree<int> arena(root);
+        runner.run("traversal", "arena_tree recursive_inorder", n, n, [&] {
+            sum = 0;
+            recursive_inorder(arena, [&sum](const arena_node<int>& node) { sum += node.value; });
+            do_not_optimize(sum);
+        });
+        runner.run("traversal", "arena_tree iterative_inorder", n, n, [&] {
+            sum = 0;
+            iterative_inorder(arena, [&sum](const arena_node<int>& node) { sum += node.value; });
+            do_not_optimize(sum);
+        });
+        runner.run("traversal", "arena_tree iterative_inorder_with_marking", n, n, [&] {
+            sum = 0;
+            iterative_inorder_with_marking(arena, [&sum](const arena_node<int>& node) { sum += node.value; });
+            do_not_optimize(sum);
+        });
+        runner.run("traversal", "arena_tree morris_inorder", n, n, [&] {
+            sum = 0;
+            morris_inorder(arena, [&sum](const arena_node<int>& node) { sum += node.value; });
+            do_not_optimize(sum);
+        });
+        runner.run("traversal", "arena_tree for_each", n, n, [&] {
+            sum = 0;
+            arena.for_each([&sum](const arena_node<int>& node) { sum += node.value; });
+            do_not_optimize(sum);
+        });
+    }
+
+    // parent-linked copy walked with stackless iterators
+    if (runner.any_enabled("traversal", {"linked_tree inorder iterator", "linked_tree postorder iterator"})) {
+        const linked_tree<int> linked(root);
+        runner.run("traversal", "linked_tree inorder iterator", n, n, [&] {
+            sum = 0;
+            for (int v : linked) {
+                sum += v;
+            }
+            do_not_optimize(sum);
+        });
+        runner.run("traversal", "linked_tree postorder iterator", n, n, [&] {
+            sum = 0;
+            for (int v : linked.postorder()) {
+                sum += v;
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    recursive_postorder(root, [](tree_node<int> *node) { delete node; });
+}
+
+// building, cloning and freeing a whole tree, per node
+static void bench_teardown(bench_runner& runner, size_t n) {
+    runner.run("teardown", "tree_node build+delete", n, n, [&] {
+        auto *root = build_tree(0, int(n));
+        recursive_postorder(root, [](tree_node<int> *node) { delete node; });
+    });
+
+    if (!runner.any_enabled("teardown", {"tree_node clone+delete", "arena_tree convert+delete", "arena_tree clone+delete"})) {
+        return;
+    }
+
+    auto *root = build_tree(0, int(n));
+    runner.run("teardown", "tree_node clone+delete", n, n, [&] {
+        // what a pointer tree clone costs: one allocation per node
+        std::function<tree_node<int>* (tree_node<int> *)> copy = [&copy](tree_node<int> *node) -> tree_node<int>* {
+            return node == nullptr ? nullptr : new tree_node<int>(node->value, copy(node->left), copy(node->right));
+        };
+        auto *clone = copy(root);
+        recursive_postorder(clone, [](tree_node<int> *node) { delete node; });
+    });
+
+    runner.run("teardown", "arena_tree convert+delete", n, n, [&] {
+        arena_tree<int> arena(root);
+        do_not_optimize(arena.size());
+    });
+
+    if (runner.enabled("teardown", "arena_tree clone+delete")) {
+        arena_tree<int> arena(root);
+        runner.run("teardown", "arena_tree clone+delete", n, n, [&] {
+            auto clone = arena.clone();
+            do_not_optimize(clone.size());
+        });
+    }
+    recursive_postorder(root, [](tree_node<int> *node) { delete node; });
+}
+
+// n random lower_bound queries over n sorted keys
+static void bench_lookup(bench_runner& runner, size_t n) {
+    if (!runner.enabled("lookup")) {
+        return;
+    }
+
+    std::vector<int> sorted(n);
+    for (size_t i = 0; i != n; ++i) {
+        sorted[i] = int(2 * i);
+    }
+
+    std::mt19937 rng(n);
+    std::vector<int> queries(n);
+    for (auto& q : queries) {
+        q = int(rng() % (2 * n));
+    }
+
+    runner.run("lookup", "std::lower_bound", n, n, [&] {
+        size_t sum = 0;
+        for (int q : queries) {
+            sum += std::lower_bound(sorted.begin(), sorted.end(), q) - sorted.begin();
+        }
+        do_not_optimize(sum);
+    });
+
+    if (runner.enabled("lookup", "eytzinger_tree")) {
+        eytzinger_tree<int> layout(sorted);
+        runner.run("lookup", "eytzinger_tree", n, n, [&] {
+            size_t sum = 0;
+            for (int q : queries) {
+                sum += layout.lower_bound(q);
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    if (runner.enabled("lookup", "veb_tree")) {
+        veb_tree<int> layout(sorted);
+        runner.run("lookup", "veb_tree", n, n, [&] {
+            size_t sum = 0;
+            for (int q : queries) {
+                sum += layout.lower_bound(q);
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    if (runner.enabled("lookup", "bplus_tree")) {
+        bplus_tree<int> tree(sorted);
+        runner.run("lookup", "bplus_tree", n, n, [&] {
+            size_t sum = 0;
+            for (int q : queries) {
+                auto it = tree.lower_bound(q);
+                sum += it != tree.end() ? *it : 0;
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    if (!runner.enabled("lookup", "tree_node")) {
+        return;
+    }
+
+    auto *root = build_tree(0, int(n));
+    runner.run("lookup", "tree_node", n, n, [&] {
+        size_t sum = 0;
+        for (int q : queries) {
+            // the tree holds 0..n-1, so search for the matching rank
+            int key = q / 2;
+            tree_node<int> *found = nullptr;
+            for (auto *node = root; node != nullptr; ) {
+                if (node->value < key) {
+                    node = node->right;
+                } else {
+                    found = node;
+                    node = node->left;
+                }
+            }
+            sum += found != nullptr ? found->value : n;
+        }
+        do_not_optimize(sum);
+    });
+    recursive_postorder(root, [](tree_node<int> *node) { delete node; });
+}
+
+// lower_bound then a 64 key sequential walk from n / 64 random starts
+template <typename Set>
+static void range_scan(bench_runner& runner, const char *name, const Set& set, const std::vector<int>& starts) {
+    runner.run("range_scan", name, set.size(), set.size(), [&] {
+        int64_t sum = 0;
+        for (int start : starts) {
+            auto it = set.lower_bound(start);
+            for (size_t j = 0; j != 64 && it != set.end(); ++j, ++it) {
+                sum += *it;
+            }
+        }
+        do_not_optimize(sum);
+    });
+}
+
+static void bench_range_scan(bench_runner& runner, size_t n) {
+    if (!runner.any_enabled("range_scan", {"bplus_tree", "std::set"})) {
+        return;
+    }
+
+    ArrayStack<int> sorted;
+    for (size_t i = 0; i != n; ++i) {
+        sorted.add(i, int(2 * i));
+    }
+
+    std::mt19937 rng(n);
+    std::vector<int> starts(std::max<size_t>(1, n / 64));
+    for (auto& start : starts) {
+        start = int(rng() % (2 * n));
+    }
+
+    if (runner.enabled("range_scan", "bplus_tree")) {
+        bplus_tree<int> tree(sorted);
+        range_scan(runner, "bplus_tree", tree, starts);
+    }
+    if (runner.enabled("range_scan", "std::set")) {
+        std::set<int> set;
+        for (size_t i = 0; i != n; ++i) {
+            set.insert(set.end(), sorted.get(i));
+        }
+        range_scan(runner, "std::set", set, starts);
+    }
+}
+
+template <typename Map>
+static void ordered_map_ops(bench_runner& runner, const std::string& name, const std::string& order,
+                            const std::vector<int>& keys, const std::vector<int>& queries) {
+    size_t n = keys.size();
+
+    runner.run("map_insert", name + " " + order, n, n, [&] {
+        Map map;
+        for (int key : keys) {
+            map.emplace(key, key);
+        }
+        do_not_optimize(map.size());
+    });
+
+    if (!runner.enabled("map_find", name + " " + order) && !runner.enabled("map_range_scan", name + " " + order)
+        && !runner.enabled("map_insert_erase", name + " " + order)) {
+        return;
+    }
+
+    Map map;
+    for (int key : keys) {
+        map.emplace(key, key);
+    }
+    runner.run("map_find", name + " " + order, n, n, [&] {
+        size_t hits = 0;
+        for (int q : queries) {
+            hits += map.find(q) != map.end();
+        }
+        do_not_optimize(hits);
+    });
+
+    runner.run("map_range_scan", name + " " + order, n, n, [&] {
+        // short range scans starting at random keys
+        int64_t sum = 0;
+        for (size_t i = 0; i < queries.size(); i += 16) {
+            auto it = map.lower_bound(queries[i]);
+            for (size_t j = 0; j != 16 && it != map.end(); ++j, ++it) {
+                sum += it->second;
+            }
+        }
+        do_not_optimize(sum);
+    });
+
+    runner.run("map_insert_erase", name + " " + order, n, n, [&] {
+        for (int q : queries) {
+            map.erase(q);
+            map.emplace(q, q);
+        }
+        do_not_optimize(map.size());
+    });
+}
+
+// random, sorted and zig-zag (alternating from both ends) insert orders;
+// the last two defeat an unbalanced tree and stress rotations
+static void bench_ordered_map(bench_runner& runner, size_t n) {
+    if (!runner.enabled("map_insert") && !runner.enabled("map_find") && !runner.enabled("map_range_scan")
+        && !runner.enabled("map_insert_erase")) {
+        return;
+    }
+
+    std::vector<int> sorted(n);
+    for (size_t i = 0; i != n; ++i) {
+        sorted[i] = int(i);
+    }
+
+    std::vector<int> random = sorted;
+    std::shuffle(random.begin(), random.end(), std::mt19937(n));
+
+    std::vector<int> zigzag;
+    zigzag.reserve(n);
+    for (size_t lo = 0, hi = n; lo < hi; ) {
+        zigzag.push_back(int(lo++));
+        if (lo < hi) {
+            zigzag.push_back(int(--hi));
+        }
+    }
+
+    std::vector<int> queries = random;
+    std::shuffle(queries.begin(), queries.end(), std::mt19937(n + 1));
+
+    for (auto& [order, keys] : {std::make_pair("random", &random), std::make_pair("sorted", &sorted),
+                                std::make_pair("zigzag", &zigzag)}) {
+        ordered_map_ops<avl_map<int, int>>(runner, "avl_map", order, *keys, queries);
+        ordered_map_ops<std::map<int, int>>(runner, "std::map", order, *keys, queries);
+    }
+}
+
+// stand-in for an expensive per-node function
+static uint64_t node_work(int value) {
+    uint64_t h = uint64_t(value);
+    for (size_t i = 0; i != 256; ++i) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h += i;
+    }
+    return h;
+}
+
+// speedup vs thread count: compare each threads=N row with the sequential one
+static void bench_parallel(bench_runner& runner, size_t n) {
+    if (!runner.enabled("parallel")) {
+        return;
+    }
+
+    auto *root = build_tree(0, int(n));
+
+    runner.run("parallel", "recursive_inorder", n, n, [&] {
+        uint64_t sum = 0;
+        recursive_inorder(root, [&sum](tree_node<int> *node) { sum += node_work(node->value); });
+        do_not_optimize(sum);
+    });
+
+    for (size_t threads : {1, 2, 4, 8}) {
+        std::string suffix = " threads=" + std::to_string(threads);
+        if (!runner.any_enabled("parallel", {"parallel_for_each" + suffix, "parallel_reduce" + suffix})) {
+            continue;
+        }
+        work_stealing_pool pool(threads);
+
+        runner.run("parallel", "parallel_for_each" + suffix, n, n, [&] {
+            std::atomic<uint64_t> sum{0};
+            parallel_for_each(pool, root, [&sum](tree_node<int> *node) {
+                sum.fetch_add(node_work(node->value), std::memory_order_relaxed);
+            });
+            do_not_optimize(sum);
+        });
+
+        runner.run("parallel", "parallel_reduce" + suffix, n, n, [&] {
+            uint64_t sum = parallel_reduce(pool, root, uint64_t(0),
+                                           [](tree_node<int> *node) { return node_work(node->value); },
+                                           [](uint64_t a, uint64_t b) { return a + b; });
+            do_not_optimize(sum);
+        });
+    }
+
+    recursive_postorder(root, [](tree_node<int> *node) { delete node; });
+}
+
+// a min-heap with push/pop/top, std::priority_queue gets std::greater
+template <typename Heap>
+static void heap_ops(bench_runner& runner, const std::string& name, const std::vector<uint64_t>& values,
+                     const std::vector<uint64_t>& steps) {
+    size_t n = values.size();
+
+    // the hold model: every op pops the minimum and pushes it back later
+    if (runner.enabled("heap_hold", name)) {
+        Heap heap(values.begin(), values.end());
+        runner.run("heap_hold", name, n, n, [&] {
+            for (uint64_t step : steps) {
+                uint64_t top = heap.top();
+                heap.pop();
+                heap.push(top + step);
+            }
+            do_not_optimize(heap.top());
+        });
+    }
+
+    runner.run("heap_drain", name, n, n, [&] {
+        Heap drained(values.begin(), values.end());
+        uint64_t sum = 0;
+        while (!drained.empty()) {
+            sum += drained.top();
+            drained.pop();
+        }
+        do_not_optimize(sum);
+    });
+}
+
+static void bench_heap(bench_runner& runner, size_t n) {
+    if (!runner.enabled("heap_hold") && !runner.enabled("heap_drain")) {
+        return;
+    }
+
+    std::mt19937_64 rng(n);
+    std::vector<uint64_t> values(n);
+    for (auto& value : values) {
+        value = rng() % (uint64_t(1) << 40);
+    }
+    std::vector<uint64_t> steps(n);
+    for (auto& step : steps) {
+        step = rng() % (uint64_t(1) << 32);
+    }
+
+    heap_ops<std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>>>(runner, "std::priority_queue", values, steps);
+    heap_ops<dary_heap<uint64_t, 2>>(runner, "dary_heap<2>", values, steps);
+    heap_ops<dary_heap<uint64_t, 4>>(runner, "dary_heap<4>", values, steps);
+    heap_ops<dary_heap<uint64_t, 8>>(runner, "dary_heap<8>", values, steps);
+
+    // handles cost a position table write per move
+    if (!runner.enabled("heap_hold", "addressable_heap<4>")) {
+        return;
+    }
+
+    addressable_heap<uint64_t, 4> addressable;
+    for (uint64_t value : values) {
+        addressable.push(value);
+    }
+    runner.run("heap_hold", "addressable_heap<4>", n, n, [&] {
+        for (uint64_t step : steps) {
+            uint64_t top = addressable.pop();
+            addressable.push(top + step);
+        }
+        do_not_optimize(addressable.top());
+    });
+}
+
+struct map_op {
+    int key;
+    uint32_t kind; // 0 find, 1 insert, 2 erase
+};
+
+// finds over [0, 2n) with the rest split between inserts and erases, so a
+// map prefilled with n keys stays around that size
+static std::vector<map_op> map_mix(size_t count, size_t n, uint32_t find_percent) {
+    std::mt19937 rng(uint32_t(n + find_percent));
+    std::vector<map_op> mix(count);
+    for (auto& op : mix) {
+        uint32_t roll = rng() % 100;
+        op.key = int(rng() % (2 * n));
+        op.kind = roll < find_percent ? 0 : 1 + roll % 2;
+    }
+    return mix;
+}
+
+// every thread replays its own slice of the mix on the shared map
+template <typename Apply>
+static void run_mix(size_t threads, const std::vector<map_op>& mix, Apply apply) {
+    std::vector<std::thread> workers;
+    size_t slice = mix.size() / threads;
+    for (size_t t = 0; t != threads; ++t) {
+        workers.emplace_back([&mix, &apply, slice, t] {
+            size_t hits = 0;
+            for (size_t i = t * slice; i != (t + 1) * slice; ++i) {
+                hits += apply(mix[i]);
+            }
+            do_not_optimize(hits);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// row name of one map under one mix, threads 0 for the single-threaded baseline
+static std::string mix_row(const std::string& map, uint32_t find_percent, size_t threads) {
+    std::string name = map + " " + std::to_string(find_percent) + "% find";
+    return threads == 0 ? name : name + " threads=" + std::to_string(threads);
+}
+
+// mixed reads and writes on one shared map: the lock-free skip list
+// against avl_map behind a mutex, with a single-threaded std::map as the
+// baseline. ns/op is wall time over all threads' operations
+static void bench_concurrent_map(bench_runner& runner, size_t n) {
+    if (!runner.enabled("concurrent_map")) {
+        return;
+    }
+
+    const std::initializer_list<uint32_t> find_percents = {90, 50};
+    const std::initializer_list<size_t> thread_counts = {1, 2, 4, 8};
+    auto wanted = [&](const std::string& name, std::initializer_list<size_t> threads) {
+        for (uint32_t find_percent : find_percents) {
+            for (size_t t : threads) {
+                if (runner.enabled("concurrent_map", mix_row(name, find_percent, t))) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    // each map is only filled when one of its rows passes the filter
+    const size_t ops = 1 << 17;
+    skip_list_map<int, int> skip_list;
+    avl_map<int, int> tree;
+    std::map<int, int> map;
+    std::mutex tree_mutex;
+    if (wanted("skip_list_map", thread_counts)) {
+        for (size_t i = 0; i != n; ++i) {
+            skip_list.insert(int(2 * i), int(i));
+        }
+    }
+    if (wanted("avl_map+mutex", thread_counts)) {
+        for (size_t i = 0; i != n; ++i) {
+            tree.insert(int(2 * i), int(i));
+        }
+    }
+    if (wanted("std::map", {0})) {
+        for (size_t i = 0; i != n; ++i) {
+            map.emplace(int(2 * i), int(i));
+        }
+    }
+
+    for (uint32_t find_percent : find_percents) {
+        auto mix = map_mix(ops, n, find_percent);
+
+        runner.run("concurrent_map", mix_row("std::map", find_percent, 0), n, ops, [&] {
+            run_mix(1, mix, [&map](const map_op& op) -> size_t {
+                switch (op.kind) {
+                    case 0: return map.find(op.key) != map.end();
+                    case 1: return map.emplace(op.key, op.key).second;
+                    default: return map.erase(op.key);
+                }
+            });
+        });
+
+        for (size_t threads : thread_counts) {
+            runner.run("concurrent_map", mix_row("skip_list_map", find_percent, threads), n, ops, [&] {
+                run_mix(threads, mix, [&skip_list](const map_op& op) -> size_t {
+                    switch (op.kind) {
+                        case 0: return skip_list.contains(op.key);
+                        case 1: return skip_list.insert(op.key, op.key);
+                        default: return skip_list.erase(op.key);
+                    }
+                });
+            });
+
+            runner.run("concurrent_map", mix_row("avl_map+mutex", find_percent, threads), n, ops, [&] {
+                run_mix(threads, mix, [&tree, &tree_mutex](const map_op& op) -> size_t {
+                    std::lock_guard<std::mutex> lock(tree_mutex);
+                    switch (op.kind) {
+                        case 0: return tree.find(op.key) != tree.end();
+                        case 1: return tree.insert(op.key, op.key);
+                        default: return tree.erase(op.key);
+                    }
+                });
+            });
+        }
+    }
+}
+
+// filter semantics, run by --self-test. the binary is built without
+// asserts, so failures are printed and reported through the exit code
+static bool self_test() {
+    bool ok = true;
+    auto check = [&ok](bool condition, const char *what) {
+        if (!condition) {
+            std::cout << "self test failed: " << what << std::endl;
+            ok = false;
+        }
+    };
+
+    // a name-only filter reaches every group that has a matching row
+    bench_runner by_name("bplus_tree");
+    check(by_name.enabled("range_scan") && by_name.enabled("lookup"), "name-only filter enables every group");
+    bench_range_scan(by_name, 100);
+    check(by_name.result_count() == 1, "name-only filter runs range_scan/bplus_tree");
+
+    bench_runner spanning("range_scan/bplus");
+    check(spanning.enabled("range_scan") && !spanning.enabled("lookup"), "group/name filter enables only its group");
+    bench_runner suffix("scan/bplus");
+    check(suffix.enabled("range_scan") && suffix.enabled("scan") && !suffix.enabled("lookup"),
+          "filter may start inside the group name");
+    bench_runner exact("queue_churn/ArrayQueue");
+    check(exact.enabled("queue_churn") && !exact.enabled("scan"), "group/name filter skips other groups");
+    bench_runner everything("");
+    check(everything.enabled("scan") && everything.enabled("scan", "std::vector"), "empty filter enables everything");
+
+    std::cout << "self test " << (ok ? "ok" : "failed") << std::endl;
+    return ok;
+}
+
+static void usage(const char *name) {
+    std::cout << "usage: " << name << " [--min-size N] [--max-size N] [--filter group/name] [--csv path] [--json path] [--self-test]" << std::endl
+              << "sizes go from min (at least 1) to max in powers of ten, defaults 1e2..1e6" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    size_t min_size = 100;
+    size_t max_size = 1000000;
+    std::string filter;
+    std::string csv;
+    std::string json;
+
+    for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--min-size") && has_value) {
+            min_size = size_t(std::atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--max-size") && has_value) {
+            max_size = size_t(std::atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--filter") && has_value) {
+            filter = argv[++i];
+        } else if (!strcmp(argv[i], "--csv") && has_value) {
+            csv = argv[++i];
+        } else if (!strcmp(argv[i], "--json") && has_value) {
+            json = argv[++i];
+        } else if (!strcmp(argv[i], "--self-test")) {
+            return self_test() ? 0 : 1;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (min_size == 0) {
+        // sizes grow by multiplying, 0 would never reach max
+        usage(argv[0]);
+        return 1;
+    }
+
+    bench_runner runner(filter);
+    bench_short_lived(runner);
+    for (size_t n = min_size; n <= max_size; n *= 10) {
+        bench_push_back(runner, n);
+        bench_positional_edit(runner, n);
+        bench_reopen(runner, n);
+        bench_queue_churn(runner, n);
+        bench_scan(runner, n);
+        bench_copy_out(runner, n);
+        bench_handoff(runner, n);
+        bench_list_sort(runner, n);
+        bench_hash(runner, n);
+        bench_heap(runner, n);
+        bench_traversal(runner, n);
+        bench_teardown(runner, n);
+        bench_lookup(runner, n);
+        bench_ordered_map(runner, n);
+        bench_range_scan(runner, n);
+        bench_parallel(runner, n);
+        bench_concurrent_map(runner, n);
+    }
+
+    if (!csv.empty()) {
+        runner.write_csv(csv);
+    }
+    if (!json.empty()) {
+        runner.write_json(json);
+    }
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// keeps the compiler from dropping a computed value
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct bench_result {
+    std::string group;
+    std::string name;
+    size_t size;
+    size_t repetitions;
+    double median_ns;
+    double p99_ns;
+    double min_ns;
+};
+
+// tiny benchmark harness: every sample runs the body enough times to last
+// ~10us, samples are repeated after a warmup and reduced to median/p99 ns/op
+class bench_runner {
+    std::vector<bench_result> results;
+    std::string filter;
+    size_t target_ops;
+
+    static constexpr size_t min_repetitions = 5;
+    static constexpr size_t max_repetitions = 101;
+    static constexpr size_t warmup_repetitions = 2;
+    static constexpr double min_sample_ns = 10000;
+
+    public:
+    bench_runner(std::string filter, size_t target_ops = 10000000)
+        : filter(std::move(filter)), target_ops(target_ops) {}
+
+    bool enabled(const std::string& group, const std::string& name) const {
+        return filter.empty() || (group + "/" + name).find(filter) != std::string::npos;
+    }
+
+    // whether any benchmark of the group may pass the filter, to skip
+    // expensive setup. names hold no '/', so a filter with one can only
+    // match across the separator, when the text before its first '/' ends
+    // the group name. a filter without one may be part of any name
+    bool enabled(const std::string& group) const {
+        size_t slash = filter.find('/');
+        if (slash == std::string::npos) {
+            return true;
+        }
+        return slash <= group.size() && group.compare(group.size() - slash, slash, filter, 0, slash) == 0;
+    }
+
+    // whether any of the named benchmarks of the group passes the filter
+    bool any_enabled(const std::string& group, std::initializer_list<std::string> names) const {
+        return std::any_of(names.begin(), names.end(), [&](const std::string& name) { return enabled(group, name); });
+    }
+
+    size_t result_count() const {
+        return results.size();
+    }
+
+    // body performs `ops` operations on a container of `size` elements
+    template <typename Body>
+    void run(const std::string& group, const std::string& name, size_t size, size_t ops, Body body) {
+        if (!enabled(group, name)) {
+            return;
+        }
+
+        size_t inner = 1;
+        for (size_t i = 0; i != warmup_repetitions; ++i) {
+            double ns = time(body, 1);
+            if (ns > 0) {
+                inner = std::max<size_t>(inner, size_t(min_sample_ns / ns) + 1);
+            }
+        }
+
+        size_t repetitions = std::clamp(target_ops / std::max<size_t>(1, ops * inner), min_repetitions, max_repetitions);
+        std::vector<double> samples;
+        samples.reserve(repetitions);
+        for (size_t i = 0; i != repetitions; ++i) {
+            samples.push_back(time(body, inner) / double(inner * ops));
+        }
+
+        std::sort(samples.begin(), samples.end());
+        size_t p99 = std::min(samples.size() - 1, (samples.size() * 99 + 99) / 100 - 1);
+        results.push_back(bench_result{group, name, size, repetitions,
+                                       samples[samples.size() / 2], samples[p99], samples.front()});
+        print(results.back());
+    }
+
+    void write_csv(const std::string& path) const {
+        std::ofstream out(path);
+        out << "group,name,size,repetitions,median_ns_per_op,p99_ns_per_op,min_ns_per_op\n";
+        for (auto& r : results) {
+            out << r.group << ',' << r.name << ',' << r.size << ',' << r.repetitions << ','
+                << r.median_ns << ',' << r.p99_ns << ',' << r.min_ns << '\n';
+        }
+    }
+
+    void write_json(const std::string& path) const {
+        std::ofstream out(path);
+        out << "[\n";
+        for (size_t i = 0; i != results.size(); ++i) {
+            auto& r = results[i];
+            out << "  {\"group\": \"" << r.group << "\", \"name\": \"" << r.name
+                << "\", \"size\": " << r.size << ", \"repetitions\": " << r.repetitions
+                << ", \"median_ns_per_op\": " << r.median_ns << ", \"p99_ns_per_op\": " << r.p99_ns
+                << ", \"min_ns_per_op\": " << r.min_ns << "}" << (i + 1 != results.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    }
+
+    private:
+    template <typename Body>
+    static double time(Body& body, size_t inner) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i != inner; ++i) {
+            body();
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static void print(const bench_result& r) {
+        std::cout << std::left << std::setw(20) << r.group << std::setw(40) << r.name
+                  << std::right << std::setw(11) << r.size
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(12) << r.median_ns << " ns/op (median)"
+                  << std::setw(12) << r.p99_ns << " ns/op (p99)" << std::endl;
+    }
+};
@@ -0,0 +1,154 @@
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "bplus_tree.hpp"
+#include "stat.hpp"
+
+template <typename Tree, typename Model>
+static void check_equal(const Tree& tree, const Model& model) {
+    assert(tree.size() == model.size());
+    assert(size_t(std::distance(tree.begin(), tree.end())) == model.size());
+    assert(std::equal(tree.begin(), tree.end(), model.begin(), model.end()));
+}
+
+// random inserts and lookups checked against std::set
+template <typename Tree>
+void test_bplus_tree_random(size_t count) {
+    using T = typename Tree::value_type;
+    Tree tree;
+    std::set<T, typename Tree::key_compare> model;
+    std::mt19937 rng(11);
+
+    for (size_t i = 0; i != count; ++i) {
+        T key = T(rng() % (count * 2));
+        assert(tree.insert(key) == model.insert(key).second);
+
+        T probe = T(rng() % (count * 2));
+        assert(tree.contains(probe) == (model.count(probe) == 1));
+        auto it = tree.lower_bound(probe);
+        auto expected = model.lower_bound(probe);
+        assert((it == tree.end()) == (expected == model.end()));
+        if (it != tree.end()) {
+            assert(*it == *expected);
+        }
+    }
+    check_equal(tree, model);
+
+    std::cout << "test_bplus_tree_random > size: " << tree.size() << " height: " << tree.height()
+              << " leaf capacity: " << Tree::leaf_capacity << " inner capacity: " << Tree::inner_capacity << std::endl;
+}
+
+// bulk loaded trees are as shallow as the fanout allows and keep
+// accepting inserts afterwards
+void test_bplus_tree_bulk_load() {
+    using tree_type = bplus_tree<int>;
+
+    for (size_t n : {0, 1, 60, 61, 62, 1000, 100000}) {
+        ArrayStack<int> sorted;
+        std::set<int> model;
+        for (size_t i = 0; i != n; ++i) {
+            sorted.add(i, int(2 * i));
+            model.insert(int(2 * i));
+        }
+
+        tree_type tree(sorted);
+        check_equal(tree, model);
+
+        size_t leaves = (n + tree_type::leaf_capacity - 1) / tree_type::leaf_capacity;
+        size_t height = n == 0 ? 0 : 1;
+        for (size_t nodes = leaves; nodes > 1; nodes = (nodes + tree_type::inner_capacity) / (tree_type::inner_capacity + 1)) {
+            ++height;
+        }
+        assert(tree.height() == height);
+
+        for (size_t i = 0; i != n; ++i) {
+            assert(tree.contains(int(2 * i)));
+            assert(!tree.contains(int(2 * i + 1)));
+            assert(*tree.lower_bound(int(2 * i) - 1) == int(2 * i));
+        }
+        assert(tree.lower_bound(int(2 * n)) == tree.end());
+
+        // odd keys land between the bulk loaded ones and split full leaves
+        for (size_t i = 0; i < n; i += 3) {
+            assert(tree.insert(int(2 * i + 1)));
+            model.insert(int(2 * i + 1));
+        }
+        check_equal(tree, model);
+    }
+
+    std::cout << "test_bplus_tree_bulk_load > ok" << std::endl;
+}
+
+// range scans follow the leaf chain
+void test_bplus_tree_range() {
+    std::vector<double> sorted;
+    for (size_t i = 0; i != 10000; ++i) {
+        sorted.push_back(double(i) / 4);
+    }
+    bplus_tree<double> tree(sorted);
+
+    double sum = 0;
+    size_t count = 0;
+    for (auto it = tree.lower_bound(100); it != tree.end() && *it < 200; ++it) {
+        sum += *it;
+        ++count;
+    }
+    assert(count == 400);
+    assert(sum == (100 + 199.75) / 2 * 400);
+
+    bplus_tree<std::string> strings;
+    for (size_t i = 0; i != 2000; ++i) {
+        strings.insert(std::to_string(i));
+    }
+    auto it = strings.lower_bound("1999");
+    assert(*it == "1999");
+    assert(*++it == "2");
+    assert(!strings.contains("2000"));
+
+    std::cout << "test_bplus_tree_range > ok" << std::endl;
+}
+
+// nodes hold raw slots, so the only keys ever built are the ones inserted
+// and every one of them is destroyed with the tree
+void test_bplus_tree_lifetimes() {
+    auto by_value = [](const cnt<0>& a, const cnt<0>& b) { return a.value < b.value; };
+    {
+        bplus_tree<cnt<0>, decltype(by_value)> tree(by_value);
+        for (size_t i = 0; i != 5000; ++i) {
+            tree.insert(cnt<0>{i * 7919 % 5000});
+        }
+        assert(!tree.insert(cnt<0>{7}));
+        assert(cnt<0>::constructed == 5001);
+        assert(tree.size() == 5000 && tree.height() > 2);
+
+        size_t expected = 0;
+        for (auto& v : tree) {
+            assert(v.value == expected++);
+        }
+
+        std::vector<cnt<0>> sorted(tree.begin(), tree.end());
+        bplus_tree<cnt<0>, decltype(by_value)> loaded(sorted, by_value);
+        assert(cnt<0>::constructed == 5001);
+        assert(std::equal(loaded.begin(), loaded.end(), sorted.begin(), sorted.end(),
+                          [](const cnt<0>& a, const cnt<0>& b) { return a.value == b.value; }));
+
+        std::cout << "test_bplus_tree_lifetimes > " << cnt<0>{} << std::endl;
+    }
+    assert(cnt<0>::constructed + cnt<0>::moved + cnt<0>::copied == cnt<0>::destroyed);
+}
+
+void _main() {
+    std::cout << "b+ tree test" << std::endl;
+    test_bplus_tree_random<bplus_tree<int>>(200000);
+    test_bplus_tree_random<bplus_tree<uint64_t, std::greater<uint64_t>>>(100000);
+    test_bplus_tree_random<bplus_tree<int, std::less<int>, 1>>(100000);
+    test_bplus_tree_bulk_load();
+    test_bplus_tree_range();
+    test_bplus_tree_lifetimes();
+}
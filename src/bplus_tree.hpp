@@ -0,0 +1,452 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "array.hpp"
+#include "flat_tree.hpp"
+
+// ordered set stored in a B+-tree. every node spans CacheLines cache
+// lines and its fanout follows from sizeof(T), so one node costs a few
+// sequential line fills instead of the miss per level of a binary tree.
+// keys live in the leaves only; inner nodes hold separators (the smallest
+// key of each right subtree). leaves are chained, so a range scan walks
+// memory in order. nodes are searched with the SIMD count from
+// flat_tree.hpp when the comparator is std::less on an arithmetic key
+template <typename T, typename Compare = std::less<T>, size_t CacheLines = 4>
+class bplus_tree {
+    static constexpr size_t node_bytes = CacheLines * cache_line_size;
+
+    public:
+    // keys per leaf and separators per inner node
+    static constexpr size_t leaf_capacity =
+        std::max<size_t>(4, (node_bytes - sizeof(void *) - sizeof(uint32_t)) / sizeof(T));
+    static constexpr size_t inner_capacity =
+        std::max<size_t>(4, (node_bytes - sizeof(uint32_t) - sizeof(void *)) / (sizeof(T) + sizeof(void *)));
+
+    private:
+    // keys sit in raw slots and only the first count of them are live, so
+    // a new node builds no T and T needs no default constructor
+    struct alignas(cache_line_size) leaf_node {
+        leaf_node *next{nullptr};
+        uint32_t count{0};
+        inline_slots<T, leaf_capacity> storage;
+
+        ~leaf_node() {
+            std::destroy(keys(), keys() + count);
+        }
+
+        T* keys() {
+            return storage.slots();
+        }
+
+        const T* keys() const {
+            return storage.slots();
+        }
+    };
+
+    struct alignas(cache_line_size) inner_node {
+        uint32_t count{0}; // separators, children are count + 1
+        inline_slots<T, inner_capacity> storage;
+        void *children[inner_capacity + 1];
+
+        ~inner_node() {
+            std::destroy(keys(), keys() + count);
+        }
+
+        T* keys() {
+            return storage.slots();
+        }
+
+        const T* keys() const {
+            return storage.slots();
+        }
+    };
+
+    static_assert(sizeof(T) > node_bytes / 4 || sizeof(leaf_node) <= node_bytes, "leaf must fit its cache lines");
+    static_assert(sizeof(T) > node_bytes / 4 || sizeof(inner_node) <= node_bytes, "inner node must fit its cache lines");
+
+    static constexpr bool simd_search = std::is_same_v<Compare, std::less<T>> && std::is_arithmetic_v<T>;
+
+    void *root{nullptr};
+    uint32_t levels{0}; // inner levels above the leaves
+    size_t length{0};
+    Compare less;
+
+    public:
+    using value_type = T;
+    using key_compare = Compare;
+
+    class const_iterator {
+        friend class bplus_tree;
+
+        const leaf_node *leaf{nullptr};
+        uint32_t idx{0};
+
+        const_iterator(const leaf_node *leaf, uint32_t idx): leaf(leaf), idx(idx) {
+            skip_exhausted();
+        }
+
+        void skip_exhausted() {
+            if (leaf != nullptr && idx == leaf->count) {
+                leaf = leaf->next;
+                idx = 0;
+            }
+        }
+
+        public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() {}
+
+        reference operator * () const {
+            return leaf->keys()[idx];
+        }
+
+        pointer operator -> () const {
+            return leaf->keys() + idx;
+        }
+
+        const_iterator& operator ++ () {
+            ++idx;
+            skip_exhausted();
+            return *this;
+        }
+
+        const_iterator operator ++ (int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator == (const const_iterator& rhs) const {
+            return leaf == rhs.leaf && idx == rhs.idx;
+        }
+
+        bool operator != (const const_iterator& rhs) const {
+            return !(*this == rhs);
+        }
+    };
+
+    using iterator = const_iterator;
+
+    bplus_tree() {}
+
+    explicit bplus_tree(Compare less): less(std::move(less)) {}
+
+    // bulk load from strictly increasing keys, leaves filled completely
+    template <typename Policy, uint32_t Inline>
+    explicit bplus_tree(ArrayStack<T, Policy, Inline>& sorted, Compare less = Compare()): less(std::move(less)) {
+        bulk_load(sorted.size(), [&sorted](size_t i) -> const T& { return sorted.get(i); });
+    }
+
+    explicit bplus_tree(const std::vector<T>& sorted, Compare less = Compare()): less(std::move(less)) {
+        bulk_load(sorted.size(), [&sorted](size_t i) -> const T& { return sorted[i]; });
+    }
+
+    bplus_tree(const bplus_tree&) = delete;
+    bplus_tree& operator = (const bplus_tree&) = delete;
+
+    bplus_tree(bplus_tree&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    bplus_tree& operator = (bplus_tree&& rhs) noexcept {
+        std::swap(root, rhs.root);
+        std::swap(levels, rhs.levels);
+        std::swap(length, rhs.length);
+        std::swap(less, rhs.less);
+        return *this;
+    }
+
+    ~bplus_tree() {
+        clear();
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    bool empty() const {
+        return length == 0;
+    }
+
+    // levels including the leaves, 0 when empty
+    size_t height() const {
+        return root != nullptr ? levels + 1 : 0;
+    }
+
+    void clear() {
+        if (root != nullptr) {
+            destroy(root, levels);
+            root = nullptr;
+        }
+        levels = 0;
+        length = 0;
+    }
+
+    const_iterator begin() const {
+        if (root == nullptr) {
+            return end();
+        }
+        void *node = root;
+        for (uint32_t level = levels; level != 0; --level) {
+            node = static_cast<inner_node *>(node)->children[0];
+        }
+        return const_iterator(static_cast<leaf_node *>(node), 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(nullptr, 0);
+    }
+
+    // first key not less than x
+    const_iterator lower_bound(const T& x) const {
+        if (root == nullptr) {
+            return end();
+        }
+        const leaf_node *leaf = find_leaf(x);
+        return const_iterator(leaf, lower_bound_in(leaf->keys(), leaf->count, x));
+    }
+
+    const_iterator find(const T& x) const {
+        auto it = lower_bound(x);
+        return it != end() && !less(x, *it) ? it : end();
+    }
+
+    bool contains(const T& x) const {
+        return find(x) != end();
+    }
+
+    // returns false if the key is already present
+    bool insert(const T& x) {
+        if (root == nullptr) {
+            auto *leaf = new leaf_node;
+            new (leaf->keys()) T(x);
+            leaf->count = 1;
+            root = leaf;
+            length = 1;
+            return true;
+        }
+
+        bool inserted = false;
+        split result = insert_into(root, levels, x, inserted);
+        if (result) {
+            // the root split, grow by one level
+            auto *node = new inner_node;
+            new (node->keys()) T(std::move(result->first));
+            node->count = 1;
+            node->children[0] = root;
+            node->children[1] = result->second;
+            root = node;
+            ++levels;
+        }
+
+        length += inserted;
+        return inserted;
+    }
+
+    private:
+    // separator and new right sibling of a node that split, empty otherwise
+    using split = std::optional<std::pair<T, void *>>;
+
+    // position of the first key not less than x
+    uint32_t lower_bound_in(const T *keys, uint32_t n, const T& x) const {
+        if constexpr (simd_search) {
+            return uint32_t(count_less(keys, n, x));
+        } else {
+            uint32_t i = 0;
+            while (i != n && less(keys[i], x)) {
+                ++i;
+            }
+            return i;
+        }
+    }
+
+    // child covering x: separators equal to x lead right
+    uint32_t child_index(const inner_node *node, const T& x) const {
+        uint32_t i = lower_bound_in(node->keys(), node->count, x);
+        return i + (i != node->count && !less(x, node->keys()[i]));
+    }
+
+    const leaf_node* find_leaf(const T& x) const {
+        const void *node = root;
+        for (uint32_t level = levels; level != 0; --level) {
+            auto *inner = static_cast<const inner_node *>(node);
+            node = inner->children[child_index(inner, x)];
+        }
+        return static_cast<const leaf_node *>(node);
+    }
+
+    split insert_into(void *node, uint32_t level, const T& x, bool& inserted) {
+        if (level == 0) {
+            return insert_into_leaf(static_cast<leaf_node *>(node), x, inserted);
+        }
+
+        auto *inner = static_cast<inner_node *>(node);
+        uint32_t c = child_index(inner, x);
+        split below = insert_into(inner->children[c], level - 1, x, inserted);
+        if (!below) {
+            return below;
+        }
+
+        if (inner->count < inner_capacity) {
+            insert_child(inner, c, std::move(*below));
+            return split{};
+        }
+
+        // split around the middle separator, which moves up
+        uint32_t mid = inner->count / 2;
+        auto *right = new inner_node;
+        std::uninitialized_move(inner->keys() + mid + 1, inner->keys() + inner->count, right->keys());
+        right->count = inner->count - mid - 1;
+        std::copy(inner->children + mid + 1, inner->children + inner->count + 1, right->children);
+        split up{std::in_place, std::move(inner->keys()[mid]), right};
+        std::destroy(inner->keys() + mid, inner->keys() + inner->count);
+        inner->count = mid;
+
+        if (c <= mid) {
+            insert_child(inner, c, std::move(*below));
+        } else {
+            insert_child(right, c - mid - 1, std::move(*below));
+        }
+        return up;
+    }
+
+    // puts the separator and right half of a split child c after it
+    static void insert_child(inner_node *node, uint32_t c, std::pair<T, void *>&& child) {
+        std::copy_backward(node->children + c + 1, node->children + node->count + 1, node->children + node->count + 2);
+        node->children[c + 1] = child.second;
+        insert_at(node->keys(), node->count, c, std::move(child.first));
+        ++node->count;
+    }
+
+    split insert_into_leaf(leaf_node *leaf, const T& x, bool& inserted) {
+        uint32_t pos = lower_bound_in(leaf->keys(), leaf->count, x);
+        if (pos != leaf->count && !less(x, leaf->keys()[pos])) {
+            return split{};
+        }
+        inserted = true;
+
+        if (leaf->count < leaf_capacity) {
+            insert_key(leaf, pos, x);
+            return split{};
+        }
+
+        uint32_t mid = leaf->count / 2;
+        auto *right = new leaf_node;
+        std::uninitialized_move(leaf->keys() + mid, leaf->keys() + leaf->count, right->keys());
+        right->count = leaf->count - mid;
+        std::destroy(leaf->keys() + mid, leaf->keys() + leaf->count);
+        leaf->count = mid;
+        right->next = leaf->next;
+        leaf->next = right;
+
+        if (pos <= mid) {
+            insert_key(leaf, pos, x);
+        } else {
+            insert_key(right, pos - mid, x);
+        }
+        return split{std::in_place, right->keys()[0], right};
+    }
+
+    static void insert_key(leaf_node *leaf, uint32_t pos, const T& x) {
+        insert_at(leaf->keys(), leaf->count, pos, x);
+        ++leaf->count;
+    }
+
+    // shifts keys[pos, count) up by one into the raw slot at count and
+    // puts x at pos
+    template <typename U>
+    static void insert_at(T *keys, uint32_t count, uint32_t pos, U&& x) {
+        if (pos == count) {
+            new (keys + count) T(std::forward<U>(x));
+            return;
+        }
+        new (keys + count) T(std::move(keys[count - 1]));
+        std::move_backward(keys + pos, keys + count - 1, keys + count);
+        keys[pos] = std::forward<U>(x);
+    }
+
+    // n items spread evenly over the fewest groups of at most capacity
+    static std::vector<size_t> group_sizes(size_t n, size_t capacity) {
+        size_t groups = (n + capacity - 1) / capacity;
+        std::vector<size_t> sizes(groups, n / groups);
+        for (size_t i = 0; i != n % groups; ++i) {
+            ++sizes[i];
+        }
+        return sizes;
+    }
+
+    template <typename Get>
+    void bulk_load(size_t n, Get get) {
+        if (n == 0) {
+            return;
+        }
+
+        // each entry is a subtree and its smallest key
+        std::vector<std::pair<void *, T>> nodes;
+        leaf_node *prev = nullptr;
+        size_t i = 0;
+        for (size_t count : group_sizes(n, leaf_capacity)) {
+            auto *leaf = new leaf_node;
+            for (size_t j = 0; j != count; ++j, ++i) {
+                assert(i == 0 || less(get(i - 1), get(i)));
+                new (leaf->keys() + j) T(get(i));
+                ++leaf->count;
+            }
+            if (prev != nullptr) {
+                prev->next = leaf;
+            }
+            prev = leaf;
+            nodes.emplace_back(leaf, leaf->keys()[0]);
+        }
+
+        while (nodes.size() > 1) {
+            std::vector<std::pair<void *, T>> parents;
+            size_t k = 0;
+            for (size_t count : group_sizes(nodes.size(), inner_capacity + 1)) {
+                auto *inner = new inner_node;
+                for (size_t j = 0; j != count; ++j, ++k) {
+                    inner->children[j] = nodes[k].first;
+                    if (j != 0) {
+                        new (inner->keys() + j - 1) T(nodes[k].second);
+                        ++inner->count;
+                    }
+                }
+                parents.emplace_back(inner, nodes[k - count].second);
+            }
+            nodes = std::move(parents);
+            ++levels;
+        }
+
+        root = nodes[0].first;
+        length = n;
+    }
+
+    static void destroy(void *node, uint32_t level) {
+        if (level == 0) {
+            delete static_cast<leaf_node *>(node);
+            return;
+        }
+
+        auto *inner = static_cast<inner_node *>(node);
+        for (uint32_t i = 0; i != inner->count + 1; ++i) {
+            destroy(inner->children[i], level - 1);
+        }
+        delete inner;
+    }
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// epoch-based memory reclamation for lock-free structures.
+// readers pin the current global epoch for the duration of an operation
+// (epoch_guard). unlinked nodes are retired with the epoch they were
+// unlinked in and freed once the global epoch is two steps ahead: by then
+// every pinned thread has entered after the unlink and can't reach them.
+// the global epoch only advances when no pinned thread lags behind it
+class epoch_reclaimer {
+    struct retired {
+        void *ptr;
+        void (*deleter)(void *);
+        uint64_t epoch;
+    };
+
+    // one per thread, recycled after the thread exits and never freed
+    struct thread_record {
+        alignas(64) std::atomic<uint64_t> epoch{0}; // 0 when not pinned
+        std::atomic<bool> in_use{true};
+        thread_record *next{nullptr};
+    };
+
+    struct thread_state {
+        thread_record *record{nullptr};
+        std::vector<retired> retired_list;
+        uint32_t pinned{0};
+        uint32_t since_scan{0};
+
+        ~thread_state() {
+            if (record == nullptr) {
+                return;
+            }
+
+            auto& self = instance();
+            if (!retired_list.empty()) {
+                std::lock_guard<std::mutex> lock(self.orphan_mutex);
+                self.orphans.insert(self.orphans.end(), retired_list.begin(), retired_list.end());
+            }
+
+            record->epoch.store(0);
+            record->in_use.store(false);
+        }
+    };
+
+    static constexpr uint32_t scan_threshold = 64;
+
+    std::atomic<uint64_t> global_epoch{1};
+    std::atomic<thread_record *> records{nullptr};
+    std::mutex orphan_mutex;
+    std::vector<retired> orphans;
+
+    public:
+    static epoch_reclaimer& instance() {
+        static epoch_reclaimer reclaimer;
+        return reclaimer;
+    }
+
+    ~epoch_reclaimer() {
+        // every thread is gone, nothing can reference retired nodes anymore
+        for (auto& r : orphans) {
+            r.deleter(r.ptr);
+        }
+
+        auto *record = records.load();
+        while (record != nullptr) {
+            auto *next = record->next;
+            delete record;
+            record = next;
+        }
+    }
+
+    void enter() {
+        auto& state = local();
+        if (state.pinned++ == 0) {
+            state.record->epoch.store(global_epoch.load());
+            // the pin must be visible before any shared pointer is read
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void exit() {
+        auto& state = local();
+        if (--state.pinned == 0) {
+            state.record->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    // ptr must already be unreachable for threads that pin after this call
+    void retire(void *ptr, void (*deleter)(void *)) {
+        auto& state = local();
+        state.retired_list.push_back(retired{ptr, deleter, global_epoch.load()});
+
+        if (++state.since_scan >= scan_threshold) {
+            state.since_scan = 0;
+            try_advance();
+            collect(state);
+        }
+    }
+
+    template <typename T>
+    void retire(T *ptr) {
+        retire(ptr, [](void *p) { delete static_cast<T *>(p); });
+    }
+
+    private:
+    epoch_reclaimer() {}
+
+    thread_state& local() {
+        thread_local thread_state state;
+        if (state.record == nullptr) {
+            state.record = acquire_record();
+        }
+        return state;
+    }
+
+    thread_record* acquire_record() {
+        for (auto *record = records.load(); record != nullptr; record = record->next) {
+            bool expected = false;
+            if (!record->in_use.load() && record->in_use.compare_exchange_strong(expected, true)) {
+                return record;
+            }
+        }
+
+        auto *record = new thread_record;
+        record->next = records.load();
+        while (!records.compare_exchange_weak(record->next, record)) {
+        }
+        return record;
+    }
+
+    void try_advance() {
+        uint64_t epoch = global_epoch.load();
+        for (auto *record = records.load(); record != nullptr; record = record->next) {
+            uint64_t local = record->epoch.load();
+            if (local != 0 && local != epoch) {
+                return;
+            }
+        }
+
+        global_epoch.compare_exchange_strong(epoch, epoch + 1);
+    }
+
+    void collect(thread_state& state) {
+        uint64_t epoch = global_epoch.load();
+        auto safe = [epoch](const retired& r) { return r.epoch + 2 <= epoch; };
+
+        free_if(state.retired_list, safe);
+
+        std::unique_lock<std::mutex> lock(orphan_mutex, std::try_to_lock);
+        if (lock.owns_lock() && !orphans.empty()) {
+            free_if(orphans, safe);
+        }
+    }
+
+    template <typename Pred>
+    static void free_if(std::vector<retired>& list, Pred safe) {
+        size_t kept = 0;
+        for (size_t i = 0; i != list.size(); ++i) {
+            if (safe(list[i])) {
+                list[i].deleter(list[i].ptr);
+            } else {
+                list[kept++] = list[i];
+            }
+        }
+        list.resize(kept);
+    }
+};
+
+// pins the current epoch for the lifetime of the guard, guards may nest
+class epoch_guard {
+    public:
+    epoch_guard() {
+        epoch_reclaimer::instance().enter();
+    }
+
+    ~epoch_guard() {
+        epoch_reclaimer::instance().exit();
+    }
+
+    epoch_guard(const epoch_guard&) = delete;
+    epoch_guard& operator = (const epoch_guard&) = delete;
+};
@@ -0,0 +1,115 @@
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <random>
+#include <string>
+#include <vector>
+#include "flat_tree.hpp"
+
+// every layout must agree with std::lower_bound on the sorted keys
+template <typename Layout, typename T>
+void check_layout(const Layout& layout, const std::vector<T>& sorted, const std::vector<T>& queries) {
+    assert(layout.size() == sorted.size());
+    for (auto& x : queries) {
+        size_t expected = std::lower_bound(sorted.begin(), sorted.end(), x) - sorted.begin();
+        assert(layout.lower_bound(x) == expected);
+        assert(layout.contains(x) == std::binary_search(sorted.begin(), sorted.end(), x));
+    }
+}
+
+void test_layouts_small() {
+    std::mt19937 rng(7);
+    for (size_t n = 0; n != 300; ++n) {
+        std::vector<int> sorted(n);
+        for (auto& v : sorted) {
+            v = int(rng() % (2 * n + 1));
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        std::vector<int> queries;
+        for (int x = -1; x <= int(2 * n + 2); ++x) {
+            queries.push_back(x);
+        }
+
+        check_layout(eytzinger_tree<int>(sorted), sorted, queries);
+        check_layout(veb_tree<int>(sorted), sorted, queries);
+    }
+    std::cout << "test_layouts_small > ok" << std::endl;
+}
+
+void test_layouts_large() {
+    std::mt19937_64 rng(11);
+    std::vector<double> sorted(100000);
+    for (auto& v : sorted) {
+        v = double(rng() % 1000000) / 7;
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<double> queries(sorted.begin(), sorted.begin() + 1000);
+    for (size_t i = 0; i != 20000; ++i) {
+        queries.push_back(double(rng() % 1100000) / 7 - 10);
+    }
+
+    check_layout(eytzinger_tree<double>(sorted), sorted, queries);
+    check_layout(veb_tree<double>(sorted), sorted, queries);
+    std::cout << "test_layouts_large > ok" << std::endl;
+}
+
+// keys without SIMD support take the scalar path
+void test_layouts_strings() {
+    std::vector<std::string> sorted;
+    for (int i = 0; i != 500; ++i) {
+        sorted.push_back(std::to_string(i * 3));
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<std::string> queries;
+    for (int i = 0; i != 1600; ++i) {
+        queries.push_back(std::to_string(i));
+    }
+
+    check_layout(eytzinger_tree<std::string>(sorted), sorted, queries);
+    check_layout(veb_tree<std::string>(sorted), sorted, queries);
+    std::cout << "test_layouts_strings > ok" << std::endl;
+}
+
+static tree_node<int>* build_bst(int lo, int hi) {
+    if (lo >= hi) {
+        return nullptr;
+    }
+
+    int mid = lo + (hi - lo) / 2;
+    return new tree_node<int>(2 * mid, build_bst(lo, mid), build_bst(mid + 1, hi));
+}
+
+void test_layout_builders() {
+    std::vector<int> sorted;
+    std::vector<int> queries;
+    for (int i = 0; i != 1000; ++i) {
+        sorted.push_back(2 * i);
+    }
+    for (int i = -1; i != 2002; ++i) {
+        queries.push_back(i);
+    }
+
+    auto *root = build_bst(0, 1000);
+    check_layout(eytzinger_tree<int>(root), sorted, queries);
+    check_layout(veb_tree<int>(root), sorted, queries);
+    recursive_postorder(root, [](tree_node<int> *node) { delete node; });
+
+    ArrayStack<int> stack;
+    for (int v : sorted) {
+        stack.add(stack.size(), v);
+    }
+    check_layout(eytzinger_tree<int>(stack), sorted, queries);
+    check_layout(veb_tree<int>(stack), sorted, queries);
+    std::cout << "test_layout_builders > ok" << std::endl;
+}
+
+void _main() {
+    std::cout << "flat tree layouts test" << std::endl;
+    test_layouts_small();
+    test_layouts_large();
+    test_layouts_strings();
+    test_layout_builders();
+}
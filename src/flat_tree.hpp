@@ -0,0 +1,396 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "array.hpp"
+#include "tree.hpp"
+
+// read-only search layouts over a sorted sequence of keys.
+// both are built over the complete binary search tree of height h
+// (2^h - 1 slots, missing keys padded with the largest key) so that the
+// inorder rank of a node follows from its BFS index alone. lookups return
+// that rank, i.e. the position in the original sorted sequence, and the
+// caller keeps payloads in a parallel array
+
+// inorder rank of the node with 1-based BFS index i at depth d
+inline size_t complete_tree_rank(size_t i, uint32_t d, uint32_t h) {
+    return ((2 * (i - (size_t(1) << d)) + 1) << (h - d - 1)) - 1;
+}
+
+inline uint32_t complete_tree_height(size_t n) {
+    uint32_t h = 0;
+    while ((size_t(1) << h) - 1 < n) {
+        ++h;
+    }
+    return h;
+}
+
+// number of keys below x, vectorized for arithmetic keys
+template <typename T>
+inline size_t count_less(const T *keys, size_t n, const T& x) {
+    size_t count = 0;
+    size_t i = 0;
+
+    if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && 16 % sizeof(T) == 0) {
+        constexpr size_t lanes = 16 / sizeof(T);
+        typedef T vec __attribute__((vector_size(16)));
+        vec xs = vec{} + x;
+
+        decltype(xs < xs) matches{};
+
+        // lanes that compare true are -1
+        for (; i + lanes <= n; i += lanes) {
+            vec v;
+            std::memcpy(&v, keys + i, sizeof(v));
+            matches += v < xs;
+        }
+        for (size_t lane = 0; lane != lanes; ++lane) {
+            count -= matches[lane];
+        }
+    }
+
+    for (; i != n; ++i) {
+        count += keys[i] < x;
+    }
+    return count;
+}
+
+// aligned raw key storage shared by the layouts
+template <typename T>
+class layout_storage {
+    T *keys{nullptr};
+    size_t length{0};
+
+    public:
+    static constexpr size_t alignment = 64;
+
+    layout_storage() {}
+
+    explicit layout_storage(size_t length): length(length) {
+        if (length != 0) {
+            keys = static_cast<T*>(::operator new(sizeof(T) * length, std::align_val_t(alignment)));
+        }
+    }
+
+    layout_storage(layout_storage&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    layout_storage& operator = (layout_storage&& rhs) noexcept {
+        if (this != &rhs) {
+            release();
+            keys = rhs.keys;
+            length = rhs.length;
+            rhs.keys = nullptr;
+            rhs.length = 0;
+        }
+        return *this;
+    }
+
+    ~layout_storage() {
+        release();
+    }
+
+    // every slot must be constructed exactly once before destruction
+    void construct(size_t idx, const T& key) {
+        new (keys + idx) T(key);
+    }
+
+    const T* data() const {
+        return keys;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    private:
+    void release() {
+        if (keys != nullptr) {
+            std::destroy(keys, keys + length);
+            ::operator delete(keys, std::align_val_t(alignment));
+            keys = nullptr;
+        }
+    }
+};
+
+template <typename T, typename Policy, uint32_t Inline>
+std::vector<T> sorted_keys(ArrayStack<T, Policy, Inline>& sorted) {
+    std::vector<T> keys;
+    keys.reserve(sorted.size());
+    for (size_t i = 0; i != sorted.size(); ++i) {
+        keys.push_back(sorted.get(i));
+    }
+    return keys;
+}
+
+template <typename T>
+std::vector<T> sorted_keys(tree_node<T> *root) {
+    std::vector<T> keys;
+    morris_inorder(root, [&keys](tree_node<T> *node) { keys.push_back(node->value); });
+    return keys;
+}
+
+// BFS (Eytzinger) order: node i has children 2i and 2i+1, so the four
+// levels below a node share one cache line that is prefetched while
+// the current level is compared. the descent has no branches
+template <typename T>
+class eytzinger_tree {
+    layout_storage<T> storage; // slot 0 unused
+    size_t length{0};
+    uint32_t height{0};
+
+    public:
+    eytzinger_tree() {}
+
+    eytzinger_tree(const T *sorted, size_t n): length(n), height(complete_tree_height(n)) {
+        if (n == 0) {
+            return;
+        }
+
+        size_t slots = size_t(1) << height;
+        storage = layout_storage<T>(slots);
+        storage.construct(0, sorted[0]);
+        fill(sorted, 1, 0);
+    }
+
+    template <typename Policy, uint32_t Inline>
+    explicit eytzinger_tree(ArrayStack<T, Policy, Inline>& sorted): eytzinger_tree(sorted_keys(sorted)) {}
+
+    // root of a binary search tree, read with an inorder walk
+    explicit eytzinger_tree(tree_node<T> *root): eytzinger_tree(sorted_keys(root)) {}
+
+    explicit eytzinger_tree(const std::vector<T>& sorted): eytzinger_tree(sorted.data(), sorted.size()) {}
+
+    size_t size() const {
+        return length;
+    }
+
+    // rank of the first key not less than x, size() if there is none
+    size_t lower_bound(const T& x) const {
+        if (length == 0) {
+            return 0;
+        }
+
+        const T *keys = storage.data();
+        constexpr size_t lookahead = layout_storage<T>::alignment / sizeof(T) > 0
+            ? layout_storage<T>::alignment / sizeof(T) : 1;
+        size_t slots = size_t(1) << height;
+        size_t k = 1;
+
+        while (k < slots) {
+            __builtin_prefetch(keys + k * lookahead);
+            k = 2 * k + (keys[k] < x);
+        }
+
+        // drop the trailing right turns and the last left turn
+        k >>= __builtin_ctzll(~k) + 1;
+        if (k == 0) {
+            return length;
+        }
+
+        uint32_t depth = 63 - __builtin_clzll(k);
+        return std::min(length, complete_tree_rank(k, depth, height));
+    }
+
+    bool contains(const T& x) const {
+        size_t rank = lower_bound(x);
+        return rank != length && !(x < key_at_rank(rank));
+    }
+
+    private:
+    const T& key_at_rank(size_t rank) const {
+        // walk down by rank, only used to confirm a hit
+        size_t k = 1;
+        for (uint32_t d = 0; ; ++d) {
+            size_t r = complete_tree_rank(k, d, height);
+            if (r == rank) {
+                return storage.data()[k];
+            }
+            k = 2 * k + (r < rank);
+        }
+    }
+
+    void fill(const T *sorted, size_t k, uint32_t depth) {
+        if (k >= (size_t(1) << height)) {
+            return;
+        }
+
+        fill(sorted, 2 * k, depth + 1);
+        size_t rank = complete_tree_rank(k, depth, height);
+        storage.construct(k, sorted[std::min(rank, length - 1)]);
+        fill(sorted, 2 * k + 1, depth + 1);
+    }
+};
+
+// van Emde Boas order: a tree of height h is split into a top tree of
+// height h/2 followed by its bottom trees, each laid out recursively, so
+// any root-to-leaf path touches O(log_B n) blocks for every block size B.
+// positions are found with per-depth tables (Brodal, Fagerberg, Jacob):
+//   pos[d] = pos[top_depth[d]] + top_size[d] + (i & top_size[d]) * bottom_size[d]
+// the lowest levels are cut into leaf blocks of about one cache line,
+// stored sorted and scanned with a SIMD count for arithmetic keys.
+// the descent is branchless; the next node's position only depends on
+// the comparison just made, so unlike eytzinger there is nothing to prefetch
+template <typename T>
+class veb_tree {
+    static constexpr uint32_t max_height = 64;
+    static constexpr uint32_t leaf_levels = sizeof(T) <= 4 ? 4 : sizeof(T) <= 8 ? 3 : 2;
+
+    layout_storage<T> upper;  // top levels in vEB order
+    layout_storage<T> leaves; // bottom levels, one sorted block per subtree
+    size_t length{0};
+    uint32_t height{0};
+    uint32_t upper_height{0};
+    size_t block_size{0};
+
+    // split of the subtree whose bottom trees are rooted at a given depth
+    struct level {
+        size_t top_size;
+        size_t bottom_size;
+        uint32_t top_depth;
+    };
+    level levels[max_height + 1]{};
+
+    public:
+    veb_tree() {}
+
+    veb_tree(const T *sorted, size_t n): length(n), height(complete_tree_height(n)) {
+        if (n == 0) {
+            return;
+        }
+
+        uint32_t leaf_height = std::min(height, leaf_levels);
+        upper_height = height - leaf_height;
+        block_size = (size_t(1) << leaf_height) - 1;
+
+        if (upper_height != 0) {
+            build_tables(0, upper_height);
+            upper = layout_storage<T>((size_t(1) << upper_height) - 1);
+            size_t pos[max_height];
+            pos[0] = 0;
+            fill_upper(sorted, 1, 0, pos);
+        }
+
+        size_t blocks = size_t(1) << upper_height;
+        leaves = layout_storage<T>(blocks * block_size);
+        for (size_t b = 0; b != blocks; ++b) {
+            for (size_t j = 0; j != block_size; ++j) {
+                size_t rank = (b << leaf_height) + j;
+                leaves.construct(b * block_size + j, sorted[std::min(rank, length - 1)]);
+            }
+        }
+    }
+
+    template <typename Policy, uint32_t Inline>
+    explicit veb_tree(ArrayStack<T, Policy, Inline>& sorted): veb_tree(sorted_keys(sorted)) {}
+
+    explicit veb_tree(tree_node<T> *root): veb_tree(sorted_keys(root)) {}
+
+    explicit veb_tree(const std::vector<T>& sorted): veb_tree(sorted.data(), sorted.size()) {}
+
+    size_t size() const {
+        return length;
+    }
+
+    // rank of the first key not less than x, size() if there is none
+    size_t lower_bound(const T& x) const {
+        if (length == 0) {
+            return 0;
+        }
+
+        const T *keys = upper.data();
+        size_t pos[max_height];
+        size_t i = 1;
+        pos[0] = 0;
+
+        for (uint32_t d = 0; d != upper_height; ++d) {
+            i = 2 * i + (keys[pos[d]] < x);
+
+            const level& next = levels[d + 1];
+            pos[d + 1] = pos[next.top_depth] + next.top_size + (i & next.top_size) * next.bottom_size;
+        }
+
+        size_t block = i - (size_t(1) << upper_height);
+        size_t below = count_less(leaves.data() + block * block_size, block_size, x);
+        if (below != block_size) {
+            return std::min(length, (block << (height - upper_height)) + below);
+        }
+
+        // every key of the block is smaller: the answer is the ancestor
+        // where the descent last turned left, as in the eytzinger search
+        i >>= __builtin_ctzll(~i) + 1;
+        if (i == 0) {
+            return length;
+        }
+        return std::min(length, complete_tree_rank(i, 63 - __builtin_clzll(i), height));
+    }
+
+    bool contains(const T& x) const {
+        size_t rank = lower_bound(x);
+        if (rank == length) {
+            return false;
+        }
+
+        // leaf keys are every rank that is not a multiple of 2^leaf_height minus one
+        size_t period = size_t(1) << (height - upper_height);
+        if ((rank + 1) % period != 0) {
+            size_t block = rank / period;
+            return !(x < leaves.data()[block * block_size + rank % period]);
+        }
+
+        return !(x < upper_key_at_rank(rank));
+    }
+
+    private:
+    // split a subtree of height h rooted at `depth` into top and bottom trees
+    void build_tables(uint32_t depth, uint32_t h) {
+        if (h <= 1) {
+            return;
+        }
+
+        uint32_t top = h / 2;
+        uint32_t bottom = h - top;
+        levels[depth + top] = level{(size_t(1) << top) - 1, (size_t(1) << bottom) - 1, depth};
+
+        build_tables(depth, top);
+        build_tables(depth + top, bottom);
+    }
+
+    void fill_upper(const T *sorted, size_t i, uint32_t d, size_t *pos) {
+        size_t rank = complete_tree_rank(i, d, height);
+        upper.construct(pos[d], sorted[std::min(rank, length - 1)]);
+
+        if (d + 1 == upper_height) {
+            return;
+        }
+
+        uint32_t next = d + 1;
+        for (size_t child = 2 * i; child != 2 * i + 2; ++child) {
+            pos[next] = pos[levels[next].top_depth] + levels[next].top_size + (child & levels[next].top_size) * levels[next].bottom_size;
+            fill_upper(sorted, child, next, pos);
+        }
+    }
+
+    const T& upper_key_at_rank(size_t rank) const {
+        size_t pos[max_height];
+        size_t i = 1;
+        pos[0] = 0;
+        for (uint32_t d = 0; ; ++d) {
+            size_t r = complete_tree_rank(i, d, height);
+            if (r == rank) {
+                return upper.data()[pos[d]];
+            }
+            i = 2 * i + (r < rank);
+            uint32_t next = d + 1;
+            pos[next] = pos[levels[next].top_depth] + levels[next].top_size + (i & levels[next].top_size) * levels[next].bottom_size;
+        }
+    }
+};
@@ -0,0 +1,115 @@
+#include <iostream>
+#include <cassert>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "hash.hpp"
+#include "stat.hpp"
+
+// random insert/erase/lookup mix checked against std::unordered_set
+void test_hash_set_random(size_t count) {
+    flat_hash_set<uint64_t> set;
+    std::unordered_set<uint64_t> model;
+    std::mt19937_64 rng(42);
+
+    for (size_t i = 0; i != count; ++i) {
+        uint64_t key = rng() % (count / 2);
+        switch (rng() % 3) {
+            case 0:
+            case 1:
+                assert(set.insert(key) == model.insert(key).second);
+                break;
+            case 2:
+                assert(set.erase(key) == (model.erase(key) == 1));
+                break;
+        }
+        assert(set.size() == model.size());
+    }
+
+    for (uint64_t key = 0; key != count / 2; ++key) {
+        assert(set.contains(key) == (model.count(key) == 1));
+    }
+
+    size_t visited = 0;
+    set.for_each([&](uint64_t key) {
+        assert(model.count(key) == 1);
+        ++visited;
+    });
+    assert(visited == model.size());
+
+    std::cout << "test_hash_set_random > size: " << set.size() << std::endl;
+}
+
+// erase-heavy churn must reuse tombstones instead of growing forever
+void test_hash_set_churn() {
+    flat_hash_set<int *> set;
+    std::vector<int> storage(64);
+
+    size_t capacity = 0;
+    for (size_t round = 0; round != 10000; ++round) {
+        for (auto& v : storage) {
+            assert(set.insert(&v));
+        }
+        for (auto& v : storage) {
+            assert(set.contains(&v));
+            assert(set.erase(&v));
+        }
+        assert(set.empty());
+        if (round == 0) {
+            capacity = set.capacity();
+        }
+    }
+    assert(set.capacity() == capacity);
+
+    std::cout << "test_hash_set_churn > ok" << std::endl;
+}
+
+void test_hash_map() {
+    {
+        flat_hash_map<std::string, cnt<0>> map;
+        for (size_t i = 0; i != 1000; ++i) {
+            assert(map.insert(std::to_string(i), cnt<0>{i}));
+        }
+        assert(!map.insert("7", cnt<0>{0}));
+        assert(map.find("7")->value == 7);
+        assert(map.find("1000") == nullptr);
+
+        const auto& view = map;
+        static_assert(std::is_same_v<decltype(view.find("7")), const cnt<0>*>);
+        static_assert(std::is_same_v<decltype(map.find("7")), cnt<0>*>);
+        assert(view.find("7") == map.find("7"));
+
+        uint32_t before = cnt<0>::constructed + cnt<0>::moved + cnt<0>::copied;
+        map["1000"].value = 1000;
+        assert(map.size() == 1001);
+        assert(map.find("1000")->value == 1000);
+        assert(cnt<0>::constructed + cnt<0>::moved + cnt<0>::copied == before + 1);
+
+        // a hit builds no value at all
+        before = cnt<0>::constructed + cnt<0>::moved + cnt<0>::copied;
+        assert(map["7"].value == 7 && map["1000"].value == 1000);
+        assert(cnt<0>::constructed + cnt<0>::moved + cnt<0>::copied == before);
+
+        for (size_t i = 0; i != 1000; i += 2) {
+            assert(map.erase(std::to_string(i)));
+        }
+        assert(map.size() == 501);
+
+        size_t sum = 0;
+        map.for_each([&sum](const std::string&, cnt<0>& v) { sum += v.value; });
+        assert(sum == 250000 + 1000);
+
+        std::cout << "test_hash_map > " << cnt<0>{} << std::endl;
+    }
+    assert(cnt<0>::constructed + cnt<0>::moved + cnt<0>::copied == cnt<0>::destroyed);
+}
+
+void _main() {
+    std::cout << "flat hash test" << std::endl;
+    test_hash_set_random(200000);
+    test_hash_set_churn();
+    test_hash_map();
+}
@@ -0,0 +1,426 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// hash functor for flat tables: std::hash does nothing for integers and
+// pointers, so the result is passed through a multiplicative mix that
+// spreads entropy into both the low bits (group index) and the high
+// 7 bits (control byte). pointers drop their alignment bits first
+template <typename K>
+struct flat_hash {
+    size_t operator () (const K& key) const {
+        return mix(std::hash<K>()(key));
+    }
+
+    static size_t mix(uint64_t h) {
+        h ^= h >> 32;
+        h *= 0x9e3779b97f4a7c15ULL;
+        return size_t(h ^ (h >> 29));
+    }
+};
+
+template <typename K>
+struct flat_hash<K*> {
+    size_t operator () (K *key) const {
+        return flat_hash<uint64_t>::mix(uint64_t(reinterpret_cast<uintptr_t>(key)) >> 3);
+    }
+};
+
+// one control byte per slot: high bit set means empty or deleted,
+// otherwise it holds the low 7 bits of the hash of the stored key
+enum ctrl_byte : int8_t {
+    ctrl_empty = -128,
+    ctrl_deleted = -2,
+};
+
+constexpr size_t flat_group_size = 16;
+
+// bitmasks over one group of 16 control bytes
+struct flat_group {
+    const int8_t *ctrl;
+
+#ifdef __SSE2__
+    uint32_t match(int8_t h2) const {
+        __m128i group = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2))));
+    }
+
+    uint32_t match_empty() const {
+        return match(ctrl_empty);
+    }
+
+    uint32_t match_free() const {
+        __m128i group = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return uint32_t(_mm_movemask_epi8(group));
+    }
+#else
+    uint32_t match(int8_t h2) const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i != flat_group_size; ++i) {
+            mask |= uint32_t(ctrl[i] == h2) << i;
+        }
+        return mask;
+    }
+
+    uint32_t match_empty() const {
+        return match(ctrl_empty);
+    }
+
+    uint32_t match_free() const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i != flat_group_size; ++i) {
+            mask |= uint32_t(ctrl[i] < 0) << i;
+        }
+        return mask;
+    }
+#endif
+};
+
+// open addressing table with a separate control byte array, probed one
+// 16-slot group at a time (SSE2 when available). groups are visited in
+// triangular order so every group is reached once the table wraps.
+// Slot is the stored type, KeyOf extracts the key from it
+template <typename Slot, typename Key, typename KeyOf, typename Hash, typename Eq>
+class flat_hash_table {
+    int8_t *ctrl{nullptr};
+    Slot *slots{nullptr};
+    size_t capacity{0};
+    size_t length{0};
+    size_t tombstones{0};
+
+    public:
+    flat_hash_table() {}
+
+    flat_hash_table(const flat_hash_table&) = delete;
+    flat_hash_table& operator = (const flat_hash_table&) = delete;
+
+    flat_hash_table(flat_hash_table&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    flat_hash_table& operator = (flat_hash_table&& rhs) noexcept {
+        if (this != &rhs) {
+            release();
+            ctrl = rhs.ctrl;
+            slots = rhs.slots;
+            capacity = rhs.capacity;
+            length = rhs.length;
+            tombstones = rhs.tombstones;
+            rhs.ctrl = nullptr;
+            rhs.slots = nullptr;
+            rhs.capacity = rhs.length = rhs.tombstones = 0;
+        }
+        return *this;
+    }
+
+    ~flat_hash_table() {
+        release();
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    // number of slots, tombstones included
+    size_t slot_count() const {
+        return capacity;
+    }
+
+    bool empty() const {
+        return length == 0;
+    }
+
+    void clear() {
+        release();
+    }
+
+    void reserve(size_t count) {
+        size_t needed = flat_group_size;
+        while (needed * 7 / 8 < count) {
+            needed <<= 1;
+        }
+        if (needed > capacity) {
+            rehash(needed);
+        }
+    }
+
+    Slot* find(const Key& key) {
+        return find_slot(key);
+    }
+
+    const Slot* find(const Key& key) const {
+        return find_slot(key);
+    }
+
+    // returns the slot of the key and whether it was inserted
+    template <typename... Args>
+    std::pair<Slot*, bool> emplace(const Key& key, Args&&... args) {
+        if (Slot *slot = find(key)) {
+            return {slot, false};
+        }
+
+        if ((length + tombstones + 1) * 8 > capacity * 7) {
+            // plenty of tombstones: rebuild in place, otherwise grow
+            rehash(length * 2 < capacity * 7 / 8 ? capacity : std::max(flat_group_size, capacity * 2));
+        }
+
+        size_t hash = Hash()(key);
+        size_t idx = free_slot(hash);
+        if (ctrl[idx] == ctrl_deleted) {
+            --tombstones;
+        }
+
+        ctrl[idx] = int8_t(hash >> 57);
+        new (slots + idx) Slot(std::forward<Args>(args)...);
+        ++length;
+        return {slots + idx, true};
+    }
+
+    bool erase(const Key& key) {
+        Slot *slot = find(key);
+        if (slot == nullptr) {
+            return false;
+        }
+
+        size_t idx = slot - slots;
+        slot->~Slot();
+        --length;
+
+        // a probe never passes a group that has an empty slot, so such a
+        // group doesn't need a tombstone to keep later keys reachable
+        flat_group g{ctrl + idx / flat_group_size * flat_group_size};
+        if (g.match_empty() != 0) {
+            ctrl[idx] = ctrl_empty;
+        } else {
+            ctrl[idx] = ctrl_deleted;
+            ++tombstones;
+        }
+        return true;
+    }
+
+    template <typename Func>
+    void for_each(Func func) {
+        for (size_t i = 0; i != capacity; ++i) {
+            if (ctrl[i] >= 0) {
+                func(slots[i]);
+            }
+        }
+    }
+
+    private:
+    // shared by both finds, which add the constness of the table
+    Slot* find_slot(const Key& key) const {
+        if (capacity == 0) {
+            return nullptr;
+        }
+
+        size_t hash = Hash()(key);
+        int8_t h2 = int8_t(hash >> 57);
+        size_t groups_mask = capacity / flat_group_size - 1;
+        size_t group = hash & groups_mask;
+
+        for (size_t step = 1; ; ++step) {
+            flat_group g{ctrl + group * flat_group_size};
+            for (uint32_t mask = g.match(h2); mask != 0; mask &= mask - 1) {
+                size_t idx = group * flat_group_size + __builtin_ctz(mask);
+                if (Eq()(KeyOf()(slots[idx]), key)) {
+                    return slots + idx;
+                }
+            }
+
+            if (g.match_empty() != 0) {
+                return nullptr;
+            }
+
+            group = (group + step) & groups_mask;
+        }
+    }
+
+    size_t free_slot(size_t hash) const {
+        size_t groups_mask = capacity / flat_group_size - 1;
+        size_t group = hash & groups_mask;
+
+        for (size_t step = 1; ; ++step) {
+            uint32_t mask = flat_group{ctrl + group * flat_group_size}.match_free();
+            if (mask != 0) {
+                return group * flat_group_size + __builtin_ctz(mask);
+            }
+            group = (group + step) & groups_mask;
+        }
+    }
+
+    void rehash(size_t new_capacity) {
+        int8_t *old_ctrl = ctrl;
+        Slot *old_slots = slots;
+        size_t old_capacity = capacity;
+
+        ctrl = static_cast<int8_t*>(::operator new(new_capacity, std::align_val_t(flat_group_size)));
+        std::memset(ctrl, ctrl_empty, new_capacity);
+        slots = static_cast<Slot*>(::operator new(new_capacity * sizeof(Slot), std::align_val_t(alignof(Slot))));
+        capacity = new_capacity;
+        tombstones = 0;
+
+        for (size_t i = 0; i != old_capacity; ++i) {
+            if (old_ctrl[i] >= 0) {
+                size_t hash = Hash()(KeyOf()(old_slots[i]));
+                size_t idx = free_slot(hash);
+                ctrl[idx] = int8_t(hash >> 57);
+                new (slots + idx) Slot(std::move(old_slots[i]));
+                old_slots[i].~Slot();
+            }
+        }
+
+        if (old_ctrl != nullptr) {
+            ::operator delete(old_ctrl, std::align_val_t(flat_group_size));
+            ::operator delete(old_slots, std::align_val_t(alignof(Slot)));
+        }
+    }
+
+    void release() {
+        if (ctrl == nullptr) {
+            return;
+        }
+
+        if constexpr (!std::is_trivially_destructible_v<Slot>) {
+            for (size_t i = 0; i != capacity; ++i) {
+                if (ctrl[i] >= 0) {
+                    slots[i].~Slot();
+                }
+            }
+        }
+
+        ::operator delete(ctrl, std::align_val_t(flat_group_size));
+        ::operator delete(slots, std::align_val_t(alignof(Slot)));
+        ctrl = nullptr;
+        slots = nullptr;
+        capacity = length = tombstones = 0;
+    }
+};
+
+template <typename K>
+struct flat_identity {
+    const K& operator () (const K& key) const {
+        return key;
+    }
+};
+
+template <typename K, typename V>
+struct flat_first {
+    const K& operator () (const std::pair<K, V>& slot) const {
+        return slot.first;
+    }
+};
+
+template <typename K, typename Hash = flat_hash<K>, typename Eq = std::equal_to<K>>
+class flat_hash_set {
+    flat_hash_table<K, K, flat_identity<K>, Hash, Eq> table;
+
+    public:
+    using value_type = K;
+
+    size_t size() const {
+        return table.size();
+    }
+
+    bool empty() const {
+        return table.empty();
+    }
+
+    size_t capacity() const {
+        return table.slot_count();
+    }
+
+    void clear() {
+        table.clear();
+    }
+
+    void reserve(size_t count) {
+        table.reserve(count);
+    }
+
+    // returns false when the key was already present
+    bool insert(const K& key) {
+        return table.emplace(key, key).second;
+    }
+
+    bool contains(const K& key) const {
+        return table.find(key) != nullptr;
+    }
+
+    bool erase(const K& key) {
+        return table.erase(key);
+    }
+
+    template <typename Func>
+    void for_each(Func func) {
+        table.for_each([&func](const K& key) { func(key); });
+    }
+};
+
+template <typename K, typename V, typename Hash = flat_hash<K>, typename Eq = std::equal_to<K>>
+class flat_hash_map {
+    using slot_type = std::pair<K, V>;
+    flat_hash_table<slot_type, K, flat_first<K, V>, Hash, Eq> table;
+
+    public:
+    using key_type = K;
+    using mapped_type = V;
+
+    size_t size() const {
+        return table.size();
+    }
+
+    bool empty() const {
+        return table.empty();
+    }
+
+    void clear() {
+        table.clear();
+    }
+
+    void reserve(size_t count) {
+        table.reserve(count);
+    }
+
+    // returns false and leaves the old value when the key was already present
+    template <typename U>
+    bool insert(const K& key, U&& value) {
+        return table.emplace(key, key, std::forward<U>(value)).second;
+    }
+
+    V* find(const K& key) {
+        slot_type *slot = table.find(key);
+        return slot != nullptr ? &slot->second : nullptr;
+    }
+
+    const V* find(const K& key) const {
+        const slot_type *slot = table.find(key);
+        return slot != nullptr ? &slot->second : nullptr;
+    }
+
+    // the default value is only built when the key is missing
+    V& operator [] (const K& key) {
+        return table.emplace(key, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple()).first->second;
+    }
+
+    bool erase(const K& key) {
+        return table.erase(key);
+    }
+
+    template <typename Func>
+    void for_each(Func func) {
+        table.for_each([&func](slot_type& slot) { func(slot.first, slot.second); });
+    }
+};
@@ -0,0 +1,183 @@
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "heap.hpp"
+
+// random pushes and pops checked against std::priority_queue
+template <typename Heap>
+void test_heap_random(size_t count) {
+    using T = typename Heap::value_type;
+    Heap heap;
+    std::priority_queue<T, std::vector<T>, std::greater<T>> model;
+    std::mt19937 rng(5);
+
+    for (size_t i = 0; i != count; ++i) {
+        if (rng() % 3 != 0 || model.empty()) {
+            T value = T(rng() % count);
+            heap.push(value);
+            model.push(value);
+        } else {
+            assert(heap.top() == model.top());
+            assert(heap.pop() == model.top());
+            model.pop();
+        }
+        assert(heap.size() == model.size());
+    }
+    while (!model.empty()) {
+        assert(heap.pop() == model.top());
+        model.pop();
+    }
+    assert(heap.empty());
+
+    std::cout << "test_heap_random > arity: " << Heap::arity << std::endl;
+}
+
+// bulk construction, non-trivial values and a max-heap comparator
+void test_heap_heapify() {
+    for (size_t n : {0, 1, 2, 3, 4, 5, 9, 17, 100, 1001}) {
+        std::vector<std::string> values;
+        for (size_t i = 0; i != n; ++i) {
+            values.push_back(std::to_string(i * 7919 % 1009));
+        }
+
+        dary_heap<std::string, 3, std::greater<std::string>> heap(values.begin(), values.end());
+        std::sort(values.begin(), values.end(), std::greater<std::string>());
+        for (auto& expected : values) {
+            assert(heap.pop() == expected);
+        }
+        assert(heap.empty());
+    }
+    std::cout << "test_heap_heapify > ok" << std::endl;
+}
+
+// decrease_key, update and erase checked against a set of (value, handle)
+void test_addressable_heap() {
+    using heap_type = addressable_heap<int, 4>;
+    heap_type heap;
+    std::set<std::pair<int, heap_type::handle>> model;
+    std::vector<heap_type::handle> live;
+    std::mt19937 rng(9);
+
+    for (size_t i = 0; i != 100000; ++i) {
+        uint32_t roll = rng() % 6;
+        if (roll < 2 || live.empty()) {
+            int value = int(rng() % 100000);
+            auto h = heap.push(value);
+            assert(!model.count({value, h}));
+            model.emplace(value, h);
+            live.push_back(h);
+            continue;
+        }
+
+        size_t pick = rng() % live.size();
+        auto h = live[pick];
+        int old = heap.get(h);
+        if (roll == 2) {
+            int value = old - int(rng() % 1000);
+            heap.decrease_key(h, value);
+            model.erase({old, h});
+            model.emplace(value, h);
+        } else if (roll == 3) {
+            int value = int(rng() % 100000);
+            heap.update(h, value);
+            model.erase({old, h});
+            model.emplace(value, h);
+        } else if (roll == 4) {
+            assert(heap.erase(h) == old);
+            assert(!heap.contains(h));
+            model.erase({old, h});
+            live[pick] = live.back();
+            live.pop_back();
+        } else {
+            auto top = heap.top_handle();
+            assert(heap.top() == model.begin()->first);
+            int value = heap.pop();
+            assert(model.erase({value, top}) == 1);
+            live.erase(std::find(live.begin(), live.end(), top));
+        }
+        assert(heap.size() == model.size());
+    }
+    while (!heap.empty()) {
+        assert(heap.pop() == model.begin()->first);
+        model.erase(model.begin());
+    }
+
+    std::cout << "test_addressable_heap > ok" << std::endl;
+}
+
+// Dijkstra with decrease_key agrees with the lazy-deletion version on
+// std::priority_queue
+void test_dijkstra() {
+    const uint32_t n = 2000;
+    std::mt19937 rng(3);
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> edges(n);
+    for (uint32_t u = 0; u != n; ++u) {
+        for (size_t k = 0; k != 8; ++k) {
+            edges[u].emplace_back(rng() % n, 1 + rng() % 100);
+        }
+    }
+
+    const uint64_t unreached = std::numeric_limits<uint64_t>::max();
+    std::vector<uint64_t> expected(n, unreached);
+    std::priority_queue<std::pair<uint64_t, uint32_t>, std::vector<std::pair<uint64_t, uint32_t>>, std::greater<>> lazy;
+    expected[0] = 0;
+    lazy.emplace(0, 0);
+    while (!lazy.empty()) {
+        auto [d, u] = lazy.top();
+        lazy.pop();
+        if (d != expected[u]) {
+            continue;
+        }
+        for (auto [v, w] : edges[u]) {
+            if (d + w < expected[v]) {
+                expected[v] = d + w;
+                lazy.emplace(d + w, v);
+            }
+        }
+    }
+
+    std::vector<uint64_t> dist(n, unreached);
+    std::vector<addressable_heap<std::pair<uint64_t, uint32_t>>::handle> handles(n);
+    std::vector<bool> queued(n, false);
+    addressable_heap<std::pair<uint64_t, uint32_t>> heap;
+    dist[0] = 0;
+    handles[0] = heap.push({0, 0});
+    queued[0] = true;
+    while (!heap.empty()) {
+        auto [d, u] = heap.pop();
+        queued[u] = false;
+        for (auto [v, w] : edges[u]) {
+            if (d + w < dist[v]) {
+                dist[v] = d + w;
+                if (queued[v]) {
+                    heap.decrease_key(handles[v], {d + w, v});
+                } else {
+                    handles[v] = heap.push({d + w, v});
+                    queued[v] = true;
+                }
+            }
+        }
+    }
+    assert(dist == expected);
+
+    std::cout << "test_dijkstra > ok" << std::endl;
+}
+
+void _main() {
+    std::cout << "d-ary heap test" << std::endl;
+    test_heap_random<dary_heap<int, 2>>(200000);
+    test_heap_random<dary_heap<int, 4>>(200000);
+    test_heap_random<dary_heap<uint64_t, 8>>(200000);
+    test_heap_random<addressable_heap<int, 4>>(200000);
+    test_heap_heapify();
+    test_addressable_heap();
+    test_dijkstra();
+}
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include "array.hpp"
+
+// sifts for an implicit Arity-ary heap in data[0, length), children of i
+// at Arity * i + 1 .. Arity * i + Arity. both work on a hole: the value
+// being placed stays out of the array, entries slide into the hole one
+// move each, and place(i, value) stores into slot i, so an owner can
+// track positions there. less(a, b) is true when a belongs above b
+
+template <uint32_t Arity, typename E, typename Less, typename Place>
+static void dary_sift_up(E *data, size_t idx, E value, Less&& less, Place&& place) {
+    while (idx != 0) {
+        size_t parent = (idx - 1) / Arity;
+        if (!less(value, data[parent])) {
+            break;
+        }
+        place(idx, std::move(data[parent]));
+        idx = parent;
+    }
+    place(idx, std::move(value));
+}
+
+template <uint32_t Arity, typename E, typename Less, typename Place>
+static void dary_sift_down(E *data, size_t length, size_t idx, E value, Less&& less, Place&& place) {
+    while (true) {
+        size_t first = idx * Arity + 1;
+        if (first >= length) {
+            break;
+        }
+
+        size_t best = first;
+        if (first + Arity <= length) {
+            // a full group: fixed trip count, unrolled by the compiler. the
+            // minimum is tracked by pointer, which compiles to conditional
+            // moves instead of unpredictable branches
+            const E *min = data + first;
+            for (size_t k = 1; k != Arity; ++k) {
+                const E *child = data + first + k;
+                min = less(*child, *min) ? child : min;
+            }
+            best = size_t(min - data);
+        } else {
+            for (size_t c = first + 1; c != length; ++c) {
+                best = less(data[c], data[best]) ? c : best;
+            }
+        }
+
+        if (!less(data[best], value)) {
+            break;
+        }
+        place(idx, std::move(data[best]));
+        idx = best;
+    }
+    place(idx, std::move(value));
+}
+
+// Floyd's bottom-up construction, O(n)
+template <uint32_t Arity, typename E, typename Less, typename Place>
+static void dary_heapify(E *data, size_t length, Less&& less, Place&& place) {
+    if (length < 2) {
+        return;
+    }
+    for (size_t i = (length - 2) / Arity + 1; i-- != 0; ) {
+        dary_sift_down<Arity>(data, length, i, std::move(data[i]), less, place);
+    }
+}
+
+// heaps drain and refill, so their storage keeps its capacity like a vector
+template <typename T>
+using heap_storage = FastArrayStack<T, never_shrink<>>;
+
+// priority queue in an implicit d-ary heap on FastArrayStack storage.
+// with Arity 4 or 8 the children of a node are adjacent and usually share
+// a cache line, so a pop reads one line per level over log_d(n) levels
+// instead of log_2(n) levels of a binary heap. top() is the least element
+// under Compare, so std::less gives a min-heap (the opposite of
+// std::priority_queue)
+template <typename T, uint32_t Arity = 4, typename Compare = std::less<T>>
+class dary_heap {
+    static_assert(Arity >= 2, "a heap needs at least two children per node");
+
+    heap_storage<T> items;
+    Compare less;
+
+    public:
+    using value_type = T;
+    using value_compare = Compare;
+
+    static constexpr uint32_t arity = Arity;
+
+    dary_heap() {}
+
+    explicit dary_heap(Compare less): less(std::move(less)) {}
+
+    // bulk construction in O(n)
+    template <typename InputIt>
+    dary_heap(InputIt first, InputIt last, Compare less = Compare()): less(std::move(less)) {
+        assign(first, last);
+    }
+
+    uint32_t size() const {
+        return items.size();
+    }
+
+    bool empty() const {
+        return items.size() == 0;
+    }
+
+    const T& top() {
+        assert(!empty());
+        return items.get(0);
+    }
+
+    void push(T value) {
+        uint32_t n = items.size();
+        items.add(n, std::move(value));
+        dary_sift_up<Arity>(data(), n, std::move(items.get(n)), less, place());
+    }
+
+    T pop() {
+        assert(!empty());
+        T result = std::move(items.get(0));
+        T last = items.remove(items.size() - 1);
+        if (!empty()) {
+            dary_sift_down<Arity>(data(), items.size(), 0, std::move(last), less, place());
+        }
+        return result;
+    }
+
+    // replaces the contents and heapifies them in O(n)
+    template <typename InputIt>
+    void assign(InputIt first, InputIt last) {
+        items = heap_storage<T>();
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+            items.reserve(uint32_t(std::max<size_t>(4, std::distance(first, last))));
+        }
+        for (; first != last; ++first) {
+            items.add(items.size(), *first);
+        }
+        dary_heapify<Arity>(data(), items.size(), less, place());
+    }
+
+    void reserve(uint32_t capacity) {
+        items.reserve(capacity);
+    }
+
+    private:
+    T* data() {
+        return &items.get(0);
+    }
+
+    auto place() {
+        return [data = data()](size_t idx, T&& value) { data[idx] = std::move(value); };
+    }
+};
+
+// dary_heap whose elements can be found again through the handle push
+// returns, for decrease_key/update/erase (Dijkstra, Prim, timers). the
+// heap holds (value, handle) pairs and a handle indexes a position table
+// that every sift step keeps current. handles of popped or erased
+// elements are reused by later pushes
+template <typename T, uint32_t Arity = 4, typename Compare = std::less<T>>
+class addressable_heap {
+    static_assert(Arity >= 2, "a heap needs at least two children per node");
+
+    public:
+    using handle = uint32_t;
+
+    private:
+    struct entry {
+        T value;
+        handle id;
+    };
+
+    static constexpr uint32_t no_position = UINT32_MAX;
+
+    heap_storage<entry> items;
+    heap_storage<uint32_t> positions; // by handle, no_position when free
+    heap_storage<handle> free_handles;
+    Compare less;
+
+    public:
+    using value_type = T;
+    using value_compare = Compare;
+
+    static constexpr uint32_t arity = Arity;
+
+    addressable_heap() {}
+
+    explicit addressable_heap(Compare less): less(std::move(less)) {}
+
+    uint32_t size() const {
+        return items.size();
+    }
+
+    bool empty() const {
+        return items.size() == 0;
+    }
+
+    const T& top() {
+        assert(!empty());
+        return items.get(0).value;
+    }
+
+    handle top_handle() {
+        assert(!empty());
+        return items.get(0).id;
+    }
+
+    // whether the handle refers to an element still in the heap
+    bool contains(handle h) {
+        return h < positions.size() && positions.get(h) != no_position;
+    }
+
+    const T& get(handle h) {
+        assert(contains(h));
+        return items.get(positions.get(h)).value;
+    }
+
+    handle push(T value) {
+        handle h;
+        if (free_handles.size() != 0) {
+            h = free_handles.remove(free_handles.size() - 1);
+        } else {
+            h = positions.size();
+            positions.add(h, no_position);
+        }
+
+        uint32_t n = items.size();
+        items.add(n, entry{std::move(value), h});
+        dary_sift_up<Arity>(data(), n, std::move(items.get(n)), entry_less(), place());
+        return h;
+    }
+
+    T pop() {
+        assert(!empty());
+        return take(0);
+    }
+
+    // moves the element toward the top: value must not be worse than the
+    // current one
+    void decrease_key(handle h, T value) {
+        assert(contains(h));
+        uint32_t idx = positions.get(h);
+        assert(!less(items.get(idx).value, value));
+        dary_sift_up<Arity>(data(), idx, entry{std::move(value), h}, entry_less(), place());
+    }
+
+    // sets a new value, moving the element whichever way it has to go
+    void update(handle h, T value) {
+        assert(contains(h));
+        uint32_t idx = positions.get(h);
+        if (less(value, items.get(idx).value)) {
+            dary_sift_up<Arity>(data(), idx, entry{std::move(value), h}, entry_less(), place());
+        } else {
+            dary_sift_down<Arity>(data(), items.size(), idx, entry{std::move(value), h}, entry_less(), place());
+        }
+    }
+
+    T erase(handle h) {
+        assert(contains(h));
+        return take(positions.get(h));
+    }
+
+    void reserve(uint32_t capacity) {
+        items.reserve(capacity);
+        positions.reserve(capacity);
+    }
+
+    private:
+    entry* data() {
+        return &items.get(0);
+    }
+
+    auto entry_less() {
+        return [this](const entry& a, const entry& b) { return less(a.value, b.value); };
+    }
+
+    auto place() {
+        return [data = data(), positions = &positions.get(0)](size_t idx, entry&& e) {
+            positions[e.id] = uint32_t(idx);
+            data[idx] = std::move(e);
+        };
+    }
+
+    // removes the entry at idx: the last entry fills the hole and moves up
+    // or down from there
+    T take(uint32_t idx) {
+        entry removed = std::move(items.get(idx));
+        entry last = items.remove(items.size() - 1);
+        positions.get(removed.id) = no_position;
+        free_handles.add(free_handles.size(), removed.id);
+
+        if (idx != items.size()) {
+            if (idx != 0 && less(last.value, items.get((idx - 1) / Arity).value)) {
+                dary_sift_up<Arity>(data(), idx, std::move(last), entry_less(), place());
+            } else {
+                dary_sift_down<Arity>(data(), items.size(), idx, std::move(last), entry_less(), place());
+            }
+        }
+        return std::move(removed.value);
+    }
+};
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include "tree.hpp"
+
+// tree node with a parent link. successors in every order follow from
+// the links alone, so iteration needs no stack, never allocates and never
+// writes to the tree: any number of threads can walk it at once
+template <typename T>
+struct linked_tree_node {
+    T value{};
+    linked_tree_node *left{nullptr};
+    linked_tree_node *right{nullptr};
+    linked_tree_node *parent{nullptr};
+
+    linked_tree_node() {}
+
+    linked_tree_node(T val): value(std::move(val)) {}
+
+    template <typename... Args>
+    linked_tree_node(std::in_place_t, Args&&... args): value(std::forward<Args>(args)...) {}
+
+    // adopts the children, setting their parent links
+    linked_tree_node(T val, linked_tree_node *left, linked_tree_node *right): value(std::move(val)), left(left), right(right) {
+        if (left != nullptr) {
+            left->parent = this;
+        }
+        if (right != nullptr) {
+            right->parent = this;
+        }
+    }
+};
+
+enum class tree_order { preorder, inorder, postorder };
+
+// first and last node of a subtree in the given order
+template <tree_order Order, typename Node>
+Node* first_in_order(Node *node) {
+    if (node == nullptr || Order == tree_order::preorder) {
+        return node;
+    }
+    while (true) {
+        if (node->left != nullptr) {
+            node = node->left;
+        } else if (Order == tree_order::postorder && node->right != nullptr) {
+            node = node->right;
+        } else {
+            return node;
+        }
+    }
+}
+
+template <tree_order Order, typename Node>
+Node* last_in_order(Node *node) {
+    if (node == nullptr || Order == tree_order::postorder) {
+        return node;
+    }
+    while (true) {
+        if (node->right != nullptr) {
+            node = node->right;
+        } else if (Order == tree_order::preorder && node->left != nullptr) {
+            node = node->left;
+        } else {
+            return node;
+        }
+    }
+}
+
+// successor, nullptr after the last node. a walk over the subtree under
+// root never climbs above it; the default walks the whole tree
+template <tree_order Order, typename Node>
+Node* next_in_order(Node *node, Node *root = nullptr) {
+    if constexpr (Order == tree_order::preorder) {
+        if (node->left != nullptr) {
+            return node->left;
+        }
+        if (node->right != nullptr) {
+            return node->right;
+        }
+        // climb until there is an unvisited right sibling
+        while (node != root && node->parent != nullptr && (node == node->parent->right || node->parent->right == nullptr)) {
+            node = node->parent;
+        }
+        return node != root && node->parent != nullptr ? node->parent->right : nullptr;
+    } else if constexpr (Order == tree_order::inorder) {
+        if (node->right != nullptr) {
+            return first_in_order<Order>(node->right);
+        }
+        while (node != root && node->parent != nullptr && node == node->parent->right) {
+            node = node->parent;
+        }
+        return node != root ? node->parent : nullptr;
+    } else {
+        Node *parent = node->parent;
+        if (node == root || parent == nullptr || node == parent->right || parent->right == nullptr) {
+            return node != root ? parent : nullptr;
+        }
+        return first_in_order<Order>(parent->right);
+    }
+}
+
+// predecessor, nullptr before the first node
+template <tree_order Order, typename Node>
+Node* prev_in_order(Node *node, Node *root = nullptr) {
+    if constexpr (Order == tree_order::preorder) {
+        Node *parent = node->parent;
+        if (node == root || parent == nullptr || node == parent->left || parent->left == nullptr) {
+            return node != root ? parent : nullptr;
+        }
+        return last_in_order<Order>(parent->left);
+    } else if constexpr (Order == tree_order::inorder) {
+        if (node->left != nullptr) {
+            return last_in_order<Order>(node->left);
+        }
+        while (node != root && node->parent != nullptr && node == node->parent->left) {
+            node = node->parent;
+        }
+        return node != root ? node->parent : nullptr;
+    } else {
+        if (node->right != nullptr) {
+            return node->right;
+        }
+        if (node->left != nullptr) {
+            return node->left;
+        }
+        // climb until there is an unvisited left sibling
+        while (node != root && node->parent != nullptr && (node == node->parent->left || node->parent->left == nullptr)) {
+            node = node->parent;
+        }
+        return node != root && node->parent != nullptr ? node->parent->left : nullptr;
+    }
+}
+
+// bidirectional iterator over the values of a subtree. end() is a null
+// node; the root is kept so that --end() finds the last node
+template <typename T, tree_order Order, bool Const>
+class linked_tree_iterator {
+    using node_type = std::conditional_t<Const, const linked_tree_node<T>, linked_tree_node<T>>;
+
+    node_type *curr{nullptr};
+    node_type *root{nullptr};
+
+    public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<Const, const T*, T*>;
+    using reference = std::conditional_t<Const, const T&, T&>;
+
+    linked_tree_iterator() {}
+
+    linked_tree_iterator(node_type *curr, node_type *root): curr(curr), root(root) {}
+
+    operator linked_tree_iterator<T, Order, true>() const {
+        return linked_tree_iterator<T, Order, true>(curr, root);
+    }
+
+    node_type* node() const {
+        return curr;
+    }
+
+    reference operator * () const {
+        return curr->value;
+    }
+
+    pointer operator -> () const {
+        return &curr->value;
+    }
+
+    linked_tree_iterator& operator ++ () {
+        curr = next_in_order<Order>(curr, root);
+        return *this;
+    }
+
+    linked_tree_iterator operator ++ (int) {
+        auto copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    linked_tree_iterator& operator -- () {
+        curr = curr != nullptr ? prev_in_order<Order>(curr, root) : last_in_order<Order>(root);
+        return *this;
+    }
+
+    linked_tree_iterator operator -- (int) {
+        auto copy = *this;
+        --*this;
+        return copy;
+    }
+
+    bool operator == (const linked_tree_iterator& rhs) const {
+        return curr == rhs.curr;
+    }
+
+    bool operator != (const linked_tree_iterator& rhs) const {
+        return curr != rhs.curr;
+    }
+};
+
+// non-owning view of a subtree in one order: the walk stays below root
+// even when root is an inner node of a larger tree
+template <typename T, tree_order Order, bool Const>
+class linked_tree_range {
+    using node_type = std::conditional_t<Const, const linked_tree_node<T>, linked_tree_node<T>>;
+
+    node_type *root;
+
+    public:
+    using iterator = linked_tree_iterator<T, Order, Const>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    explicit linked_tree_range(node_type *root): root(root) {}
+
+    iterator begin() const {
+        return iterator(first_in_order<Order>(root), root);
+    }
+
+    iterator end() const {
+        return iterator(nullptr, root);
+    }
+
+    reverse_iterator rbegin() const {
+        return reverse_iterator(end());
+    }
+
+    reverse_iterator rend() const {
+        return reverse_iterator(begin());
+    }
+};
+
+// owning tree of parent-linked nodes. range-for walks it in inorder,
+// preorder()/postorder() give the other orders
+template <typename T>
+class linked_tree {
+    using node_type = linked_tree_node<T>;
+
+    node_type *root{nullptr};
+
+    public:
+    using value_type = T;
+    using iterator = linked_tree_iterator<T, tree_order::inorder, false>;
+    using const_iterator = linked_tree_iterator<T, tree_order::inorder, true>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    linked_tree() {}
+
+    // takes ownership of nodes built with the linking constructor
+    explicit linked_tree(node_type *root): root(root) {
+        if (root != nullptr) {
+            root->parent = nullptr;
+        }
+    }
+
+    // copies the shape and values of a plain tree
+    explicit linked_tree(tree_node<T> *source): root(copy(source, nullptr)) {}
+
+    linked_tree(const linked_tree&) = delete;
+    linked_tree& operator = (const linked_tree&) = delete;
+
+    linked_tree(linked_tree&& rhs) noexcept: root(rhs.root) {
+        rhs.root = nullptr;
+    }
+
+    linked_tree& operator = (linked_tree&& rhs) noexcept {
+        std::swap(root, rhs.root);
+        return *this;
+    }
+
+    ~linked_tree() {
+        clear();
+    }
+
+    // postorder teardown, also without a stack: the successor is taken
+    // before a node is freed and never points into freed nodes
+    void clear() {
+        for (node_type *node = first_in_order<tree_order::postorder>(root); node != nullptr; ) {
+            node_type *next = next_in_order<tree_order::postorder>(node);
+            delete node;
+            node = next;
+        }
+        root = nullptr;
+    }
+
+    node_type* get_root() {
+        return root;
+    }
+
+    const node_type* get_root() const {
+        return root;
+    }
+
+    bool empty() const {
+        return root == nullptr;
+    }
+
+    iterator begin() {
+        return iterator(first_in_order<tree_order::inorder>(root), root);
+    }
+
+    iterator end() {
+        return iterator(nullptr, root);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(first_in_order<tree_order::inorder>(const_cast<const node_type *>(root)), root);
+    }
+
+    const_iterator end() const {
+        return const_iterator(nullptr, root);
+    }
+
+    reverse_iterator rbegin() {
+        return reverse_iterator(end());
+    }
+
+    reverse_iterator rend() {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(end());
+    }
+
+    const_reverse_iterator rend() const {
+        return const_reverse_iterator(begin());
+    }
+
+    linked_tree_range<T, tree_order::preorder, false> preorder() {
+        return linked_tree_range<T, tree_order::preorder, false>(root);
+    }
+
+    linked_tree_range<T, tree_order::inorder, false> inorder() {
+        return linked_tree_range<T, tree_order::inorder, false>(root);
+    }
+
+    linked_tree_range<T, tree_order::postorder, false> postorder() {
+        return linked_tree_range<T, tree_order::postorder, false>(root);
+    }
+
+    linked_tree_range<T, tree_order::preorder, true> preorder() const {
+        return linked_tree_range<T, tree_order::preorder, true>(root);
+    }
+
+    linked_tree_range<T, tree_order::inorder, true> inorder() const {
+        return linked_tree_range<T, tree_order::inorder, true>(root);
+    }
+
+    linked_tree_range<T, tree_order::postorder, true> postorder() const {
+        return linked_tree_range<T, tree_order::postorder, true>(root);
+    }
+
+    private:
+    static node_type* copy(tree_node<T> *source, node_type *parent) {
+        if (source == nullptr) {
+            return nullptr;
+        }
+
+        auto *node = new node_type(source->value);
+        node->parent = parent;
+        node->left = copy(source->left, node);
+        node->right = copy(source->right, node);
+        return node;
+    }
+};
@@ -1,112 +1,17 @@
 #include <iostream>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "list.hpp"
 #include "stat.hpp"
 
-template <typename T>
-class SinglyLinkedList {
-    struct Node {
-        Node *next{nullptr};
-        T value;
-
-        template <typename U>
-        Node(U&& v): value(std::move(v)) {}
-    };
-
-    Node *head{nullptr};
-    Node *tail{nullptr};
-    size_t length{0};
-
-    public:
-
-    SinglyLinkedList() {}
-
-    SinglyLinkedList(const SinglyLinkedList&) = delete;
-
-    SinglyLinkedList(SinglyLinkedList&& rhs) noexcept {
-        *this = std::move(rhs);
-    }
-
-    SinglyLinkedList& operator = (const SinglyLinkedList&) = delete;
-    SinglyLinkedList& operator = (SinglyLinkedList&& rhs) noexcept {
-        head = rhs.head;
-        tail = rhs.tail;
-        length = rhs.length;
-        rhs.head = nullptr;
-        rhs.tail = nullptr;
-        rhs.length = 0;
-        return *this;
-    }
-
-    ~SinglyLinkedList() {
-        while (head != nullptr) {
-            auto *next = head->next;
-            delete head;
-            head = next;
-        }
-    }
-
-    auto size() const {
-        return length;
-    }
-
-    auto empty() const {
-        return length == 0;
-    }
-
-    T& peek() {
-        assert(head != nullptr);
-        return head->value;
-    }
-
-    template <typename U>
-    void add(U&& value) {
-        if (tail == nullptr) {
-            head = tail = new Node(std::move(value));
-        } else {
-            auto *node = new Node(std::move(value));
-            tail->next = node;
-            tail = node;
-        }
-
-        ++length;
-    }
-
-    T remove() {
-        assert(head != nullptr);
-        T val(std::move(head->value));
-        Node *tmp = head;
-        head = head->next;
-        if (head == nullptr) {
-            tail = nullptr;
-        }
-
-        delete tmp;
-        --length;
-
-        return val;
-    }
-
-    template <typename U>
-    void push(U&& value) {
-        auto *node = new Node(std::move(value));
-
-        if (tail == nullptr) {
-            head = tail = node;
-        } else {
-            node->next = head;
-            head = node;
-        }
-
-        ++length;
-    }
-
-    T pop() {
-        return remove();
-    }
-};
-
-template <typename T, template<typename> typename List>
-void test_list_add(List<T>& list, size_t count) {
+template <typename List>
+void test_list_add(List& list, size_t count) {
+    using T = typename List::value_type;
     for (size_t i = 0; i != count; ++i) {
         list.add(T{i});
     }
@@ -115,8 +20,9 @@ void test_list_add(List<T>& list, size_t count) {
     std::cout << "test_list_add > " << list.peek() << std::endl;
 }
 
-template <typename T, template<typename> typename List>
-void test_list_remove(List<T>& list, size_t count) {
+template <typename List>
+void test_list_remove(List& list, size_t count) {
+    using T = typename List::value_type;
     for (size_t i = 0; i != count; ++i) {
         T c = list.remove();
         assert(c.value == i);
@@ -127,8 +33,9 @@ void test_list_remove(List<T>& list, size_t count) {
     std::cout << "test_list_remove > " << T{0} << std::endl;
 }
 
-template <typename T, template<typename> typename List>
-void test_list_push(List<T>& list, size_t count) {
+template <typename List>
+void test_list_push(List& list, size_t count) {
+    using T = typename List::value_type;
     for (size_t i = 0; i != count; ++i) {
         list.push(T{i});
     }
@@ -137,8 +44,9 @@ void test_list_push(List<T>& list, size_t count) {
     std::cout << "test_list_push > " << list.peek() << std::endl;
 }
 
-template <typename T, template<typename> typename List>
-void test_list_pop(List<T>& list, size_t count) {
+template <typename List>
+void test_list_pop(List& list, size_t count) {
+    using T = typename List::value_type;
     for (size_t i = 0; i != count; ++i) {
         T c = list.pop();
         assert(c.value == count - i - 1);
@@ -163,8 +71,263 @@ void test_singly_linked_list() {
         test_list_push(list, 7);
         test_list_pop(list, 7);
     }
+
+    {
+        SinglyLinkedList<size_t> list;
+        for (size_t i = 0; i != 7; ++i) {
+            list.add(i);
+        }
+        size_t expected = 0;
+        for (auto v : list) {
+            assert(v == expected++);
+        }
+        assert(expected == 7);
+    }
+}
+
+template <typename List>
+void test_list_churn(List& list, size_t count, size_t rounds) {
+    using T = typename List::value_type;
+    test_list_add(list, count);
+    auto slabs = list.get_allocator().slabs_allocated();
+
+    // queue-style traffic recycles freed nodes, the pool must not grow
+    for (size_t i = 0; i != rounds; ++i) {
+        T c = list.remove();
+        assert(c.value == i);
+        list.add(T{count + i});
+    }
+
+    assert(list.size() == count);
+    assert(list.get_allocator().slabs_allocated() == slabs);
+    std::cout << "test_list_churn > slabs: " << slabs << ", " << list.peek() << std::endl;
+}
+
+void test_pooled_list() {
+    std::cout << "pooled SinglyLinkedList test" << std::endl;
+    {
+        SinglyLinkedList<cnt<2>> list;
+        test_list_churn(list, 100, 1000);
+    }
+    std::cout << "test_pooled_list destroyed > " << cnt<2>{0} << std::endl;
+
+    {
+        SinglyLinkedList<cnt<3>, std::allocator<cnt<3>>> list;
+        test_list_add(list, 7);
+        test_list_remove(list, 7);
+    }
+}
+
+void test_unrolled_list() {
+    std::cout << "UnrolledLinkedList test" << std::endl;
+    {
+        // tiny blocks so that every operation crosses node boundaries
+        UnrolledLinkedList<cnt<5>, PoolAllocator<cnt<5>>, 3> list;
+        test_list_add(list, 7);
+        test_list_remove(list, 7);
+        test_list_push(list, 7);
+        test_list_pop(list, 7);
+        test_list_churn(list, 100, 1000);
+    }
+    assert(cnt<5>::constructed + cnt<5>::moved == cnt<5>::destroyed);
+
+    {
+        // mixed ends: pushes go in front of adds, iteration sees both
+        UnrolledLinkedList<size_t, std::allocator<size_t>, 4> list;
+        std::vector<size_t> model;
+        for (size_t i = 0; i != 50; ++i) {
+            list.add(i);
+            model.push_back(i);
+            if (i % 3 == 0) {
+                list.push(1000 + i);
+                model.insert(model.begin(), 1000 + i);
+            }
+            if (i % 7 == 0) {
+                assert(list.remove() == model.front());
+                model.erase(model.begin());
+            }
+        }
+        assert(list.size() == model.size());
+        assert(std::equal(list.begin(), list.end(), model.begin(), model.end()));
+
+        while (!list.empty()) {
+            list.pop();
+        }
+        assert(list.begin() == list.end());
+        list.push(size_t(1));
+        list.add(size_t(2));
+        assert(list.peek() == 1 && *++list.begin() == 2);
+    }
+
+    std::cout << "test_unrolled_list > block size: " << UnrolledLinkedList<uint64_t>::block_size << std::endl;
+}
+
+struct work_item : IntrusiveListHook<>, IntrusiveListHook<struct by_owner> {
+    int key;
+    size_t seq;
+};
+
+void test_intrusive_list() {
+    std::cout << "IntrusiveList test" << std::endl;
+
+    std::vector<work_item> items(1000);
+    std::mt19937 rng(3);
+    for (size_t i = 0; i != items.size(); ++i) {
+        items[i].key = int(rng() % 50);
+        items[i].seq = i;
+    }
+
+    // producers hand their batches over in O(1)
+    IntrusiveList<work_item> batches[4];
+    for (auto& item : items) {
+        batches[item.seq % 4].add(item);
+    }
+    IntrusiveList<work_item> all;
+    for (auto& batch : batches) {
+        all.splice(batch);
+        assert(batch.empty() && batch.begin() == batch.end());
+    }
+    assert(all.size() == items.size());
+    all.splice(batches[0]);
+    batches[0].splice(all);
+    all = std::move(batches[0]);
+    assert(all.size() == items.size() && batches[0].empty());
+
+    // the same items can be linked into a second list through the other hook
+    IntrusiveList<work_item, by_owner> owned;
+    for (auto& item : items) {
+        owned.push(item);
+    }
+    assert(&owned.peek() == &items.back());
+
+    std::vector<work_item *> model;
+    for (auto& item : all) {
+        model.push_back(&item);
+    }
+    auto by_key = [](const work_item& a, const work_item& b) { return a.key < b.key; };
+    std::stable_sort(model.begin(), model.end(), [&](auto *a, auto *b) { return by_key(*a, *b); });
+    all.sort(by_key);
+    assert(std::equal(all.begin(), all.end(), model.begin(), model.end(),
+                      [](const work_item& a, const work_item *b) { return &a == b; }));
+
+    // the tail survives the sort
+    work_item& first = all.remove();
+    assert(&first == model.front());
+    all.add(first);
+    work_item *last = nullptr;
+    for (auto& item : all) {
+        last = &item;
+    }
+    assert(last == &first && all.size() == items.size());
+    all.clear();
+    owned.sort([](const work_item& a, const work_item& b) { return a.seq < b.seq; });
+    for (size_t i = 0; i != items.size(); ++i) {
+        assert(&owned.pop() == &items[i]);
+    }
+    assert(owned.empty());
+
+    IntrusiveList<work_item> front, back;
+    for (size_t i = 0; i != 10; ++i) {
+        (i < 5 ? front : back).add(items[i]);
+    }
+    back.splice_front(front);
+    for (size_t i = 0; i != 10; ++i) {
+        assert(&back.remove() == &items[i]);
+    }
+
+    std::cout << "test_intrusive_list > ok" << std::endl;
+}
+
+void test_concurrent_queue() {
+    std::cout << "ConcurrentLinkedQueue test" << std::endl;
+    static_assert(sizeof(ConcurrentLinkedQueue<cnt<4>>) % 64 == 0);
+    {
+        ConcurrentLinkedQueue<cnt<4>> queue;
+        for (size_t i = 0; i != 100; ++i) {
+            queue.add(cnt<4>{i});
+        }
+
+        cnt<4> c;
+        for (size_t i = 0; i != 50; ++i) {
+            assert(queue.try_remove(c) && c.value == i);
+        }
+        std::cout << "test_concurrent_queue > " << c << std::endl;
+    }
+    // the remaining values are destroyed with the queue
+    assert(cnt<4>::constructed + cnt<4>::moved == cnt<4>::destroyed);
+}
+
+// N producers and M consumers hammer one queue. every message carries its
+// producer and sequence number: consumers check per-producer FIFO order and
+// that every message arrives exactly once
+void run_concurrent_queue_stress(size_t producers, size_t consumers, size_t per_producer) {
+    ConcurrentLinkedQueue<std::pair<size_t, size_t>> queue;
+    std::atomic<size_t> consumed{0};
+    std::vector<size_t> received(producers, 0);
+    std::vector<std::thread> threads;
+    const size_t total = producers * per_producer;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t p = 0; p != producers; ++p) {
+        threads.emplace_back([&queue, p, per_producer] {
+            for (size_t seq = 0; seq != per_producer; ++seq) {
+                queue.add(std::pair<size_t, size_t>(p, seq));
+            }
+        });
+    }
+
+    std::vector<std::vector<size_t>> counts(consumers, std::vector<size_t>(producers, 0));
+    for (size_t c = 0; c != consumers; ++c) {
+        threads.emplace_back([&, c] {
+            std::vector<size_t> last(producers, 0);
+            std::pair<size_t, size_t> msg;
+            while (consumed.load(std::memory_order_relaxed) != total) {
+                if (!queue.try_remove(msg)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                consumed.fetch_add(1, std::memory_order_relaxed);
+                assert(counts[c][msg.first] == 0 || msg.second > last[msg.first]);
+                last[msg.first] = msg.second;
+                ++counts[c][msg.first];
+            }
+        });
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (size_t c = 0; c != consumers; ++c) {
+        for (size_t p = 0; p != producers; ++p) {
+            received[p] += counts[c][p];
+        }
+    }
+    for (size_t p = 0; p != producers; ++p) {
+        assert(received[p] == per_producer);
+    }
+
+    std::cout << "concurrent queue " << producers << "p/" << consumers << "c > "
+              << total / elapsed / 1e6 << " Mops/s" << std::endl;
+}
+
+void test_concurrent_queue_stress() {
+    std::cout << "ConcurrentLinkedQueue stress test" << std::endl;
+    run_concurrent_queue_stress(1, 1, 200000);
+    run_concurrent_queue_stress(2, 2, 100000);
+    run_concurrent_queue_stress(4, 4, 50000);
+    run_concurrent_queue_stress(8, 2, 25000);
 }
 
 void _main() {
     test_singly_linked_list();
+    test_pooled_list();
+    test_unrolled_list();
+    test_intrusive_list();
+    test_concurrent_queue();
+    test_concurrent_queue_stress();
 }
\ No newline at end of file
@@ -0,0 +1,830 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "epoch.hpp"
+#include "pool.hpp"
+
+template <typename T, typename Allocator = PoolAllocator<T>>
+class SinglyLinkedList {
+    struct Node {
+        Node *next{nullptr};
+        T value;
+
+        template <typename U>
+        Node(U&& v): value(std::move(v)) {}
+    };
+
+    using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_traits = std::allocator_traits<node_allocator>;
+
+    Node *head{nullptr};
+    Node *tail{nullptr};
+    size_t length{0};
+    node_allocator alloc;
+
+    public:
+    using value_type = T;
+    using allocator_type = node_allocator;
+
+    SinglyLinkedList() {}
+
+    SinglyLinkedList(const SinglyLinkedList&) = delete;
+
+    SinglyLinkedList(SinglyLinkedList&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    SinglyLinkedList& operator = (const SinglyLinkedList&) = delete;
+    SinglyLinkedList& operator = (SinglyLinkedList&& rhs) noexcept {
+        clear();
+        alloc = std::move(rhs.alloc);
+        head = rhs.head;
+        tail = rhs.tail;
+        length = rhs.length;
+        rhs.head = nullptr;
+        rhs.tail = nullptr;
+        rhs.length = 0;
+        return *this;
+    }
+
+    ~SinglyLinkedList() {
+        clear();
+    }
+
+    auto size() const {
+        return length;
+    }
+
+    auto empty() const {
+        return length == 0;
+    }
+
+    const allocator_type& get_allocator() const {
+        return alloc;
+    }
+
+    void clear() {
+        // a pooled list of trivially destructible values is dropped slab by slab
+        if constexpr (!is_bulk_release_v<node_allocator> || !std::is_trivially_destructible_v<T>) {
+            while (head != nullptr) {
+                auto *next = head->next;
+                if constexpr (is_bulk_release_v<node_allocator>) {
+                    node_traits::destroy(alloc, head);
+                } else {
+                    destroy_node(head);
+                }
+                head = next;
+            }
+        }
+
+        if constexpr (is_bulk_release_v<node_allocator>) {
+            alloc.release();
+        }
+
+        head = tail = nullptr;
+        length = 0;
+    }
+
+    T& peek() {
+        assert(head != nullptr);
+        return head->value;
+    }
+
+    template <typename U>
+    void add(U&& value) {
+        if (tail == nullptr) {
+            head = tail = create_node(std::move(value));
+        } else {
+            auto *node = create_node(std::move(value));
+            tail->next = node;
+            tail = node;
+        }
+
+        ++length;
+    }
+
+    T remove() {
+        assert(head != nullptr);
+        T val(std::move(head->value));
+        Node *tmp = head;
+        head = head->next;
+        if (head == nullptr) {
+            tail = nullptr;
+        }
+
+        destroy_node(tmp);
+        --length;
+
+        return val;
+    }
+
+    template <typename U>
+    void push(U&& value) {
+        auto *node = create_node(std::move(value));
+
+        if (tail == nullptr) {
+            head = tail = node;
+        } else {
+            node->next = head;
+            head = node;
+        }
+
+        ++length;
+    }
+
+    T pop() {
+        return remove();
+    }
+
+    class iterator {
+        Node *node{nullptr};
+
+        public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        iterator() {}
+
+        explicit iterator(Node *node): node(node) {}
+
+        T& operator * () const {
+            return node->value;
+        }
+
+        T* operator -> () const {
+            return &node->value;
+        }
+
+        iterator& operator ++ () {
+            node = node->next;
+            return *this;
+        }
+
+        iterator operator ++ (int) {
+            auto copy = *this;
+            node = node->next;
+            return copy;
+        }
+
+        bool operator == (const iterator& rhs) const {
+            return node == rhs.node;
+        }
+
+        bool operator != (const iterator& rhs) const {
+            return node != rhs.node;
+        }
+    };
+
+    iterator begin() {
+        return iterator(head);
+    }
+
+    iterator end() {
+        return iterator();
+    }
+
+    private:
+    template <typename U>
+    Node* create_node(U&& value) {
+        Node *node = node_traits::allocate(alloc, 1);
+        node_traits::construct(alloc, node, std::move(value));
+        return node;
+    }
+
+    void destroy_node(Node *node) {
+        node_traits::destroy(alloc, node);
+        node_traits::deallocate(alloc, node, 1);
+    }
+};
+
+// elements per UnrolledLinkedList node: enough to fill CacheLines cache
+// lines together with the node header
+template <typename T, size_t CacheLines = 4>
+constexpr size_t unrolled_block_size() {
+    size_t header = sizeof(void *) + 2 * sizeof(uint32_t);
+    size_t bytes = CacheLines * 64;
+    return bytes > header + 4 * sizeof(T) ? (bytes - header) / sizeof(T) : 4;
+}
+
+// SinglyLinkedList with K elements per node. every node holds a window
+// [begin, end) of its inline block: add fills the tail block forwards,
+// push fills the head block backwards, so both ends stay O(1) and a scan
+// reads K neighbouring elements per pointer it follows
+template <typename T, typename Allocator = PoolAllocator<T>, size_t K = unrolled_block_size<T>()>
+class UnrolledLinkedList {
+    static_assert(K != 0, "node must hold at least one element");
+
+    struct Node {
+        Node *next{nullptr};
+        uint32_t begin{0};
+        uint32_t end{0};
+        alignas(T) unsigned char storage[K * sizeof(T)];
+
+        // user-provided so that construction leaves the block uninitialized
+        Node() {}
+
+        T* slots() {
+            return reinterpret_cast<T*>(storage);
+        }
+
+        bool empty() const {
+            return begin == end;
+        }
+    };
+
+    using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_traits = std::allocator_traits<node_allocator>;
+
+    Node *head{nullptr};
+    Node *tail{nullptr};
+    size_t length{0};
+    node_allocator alloc;
+
+    public:
+    using value_type = T;
+    using allocator_type = node_allocator;
+
+    static constexpr size_t block_size = K;
+
+    UnrolledLinkedList() {}
+
+    UnrolledLinkedList(const UnrolledLinkedList&) = delete;
+
+    UnrolledLinkedList(UnrolledLinkedList&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    UnrolledLinkedList& operator = (const UnrolledLinkedList&) = delete;
+    UnrolledLinkedList& operator = (UnrolledLinkedList&& rhs) noexcept {
+        clear();
+        alloc = std::move(rhs.alloc);
+        head = rhs.head;
+        tail = rhs.tail;
+        length = rhs.length;
+        rhs.head = nullptr;
+        rhs.tail = nullptr;
+        rhs.length = 0;
+        return *this;
+    }
+
+    ~UnrolledLinkedList() {
+        clear();
+    }
+
+    auto size() const {
+        return length;
+    }
+
+    auto empty() const {
+        return length == 0;
+    }
+
+    const allocator_type& get_allocator() const {
+        return alloc;
+    }
+
+    void clear() {
+        if constexpr (!is_bulk_release_v<node_allocator> || !std::is_trivially_destructible_v<T>) {
+            while (head != nullptr) {
+                auto *next = head->next;
+                for (uint32_t i = head->begin; i != head->end; ++i) {
+                    head->slots()[i].~T();
+                }
+                destroy_node(head);
+                head = next;
+            }
+        }
+
+        if constexpr (is_bulk_release_v<node_allocator>) {
+            alloc.release();
+        }
+
+        head = tail = nullptr;
+        length = 0;
+    }
+
+    T& peek() {
+        assert(length != 0);
+        return head->slots()[head->begin];
+    }
+
+    template <typename U>
+    void add(U&& value) {
+        if (tail != nullptr && tail->empty()) {
+            tail->begin = tail->end = 0;
+        }
+
+        if (tail == nullptr || tail->end == K) {
+            Node *node = create_node(0);
+            if (tail == nullptr) {
+                head = tail = node;
+            } else {
+                tail->next = node;
+                tail = node;
+            }
+        }
+
+        new (tail->slots() + tail->end) T(std::move(value));
+        ++tail->end;
+        ++length;
+    }
+
+    T remove() {
+        assert(length != 0);
+        T *slot = head->slots() + head->begin;
+        T val(std::move(*slot));
+        slot->~T();
+        ++head->begin;
+        --length;
+
+        // the last node stays allocated, queue churn then never leaves it
+        if (head->empty() && head != tail) {
+            Node *tmp = head;
+            head = head->next;
+            destroy_node(tmp);
+        }
+
+        return val;
+    }
+
+    template <typename U>
+    void push(U&& value) {
+        if (head != nullptr && head->empty()) {
+            head->begin = head->end = K;
+        }
+
+        if (head == nullptr || head->begin == 0) {
+            Node *node = create_node(K);
+            node->next = head;
+            head = node;
+            if (tail == nullptr) {
+                tail = node;
+            }
+        }
+
+        --head->begin;
+        new (head->slots() + head->begin) T(std::move(value));
+        ++length;
+    }
+
+    T pop() {
+        return remove();
+    }
+
+    // walks a block with a bare pointer, the node is only read at block ends
+    class iterator {
+        Node *node{nullptr};
+        T *curr{nullptr};
+        T *last{nullptr};
+
+        public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        iterator() {}
+
+        explicit iterator(Node *node): node(node) {
+            enter_block();
+        }
+
+        T& operator * () const {
+            return *curr;
+        }
+
+        T* operator -> () const {
+            return curr;
+        }
+
+        iterator& operator ++ () {
+            if (++curr == last) {
+                node = node->next;
+                enter_block();
+            }
+            return *this;
+        }
+
+        iterator operator ++ (int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator == (const iterator& rhs) const {
+            return curr == rhs.curr;
+        }
+
+        bool operator != (const iterator& rhs) const {
+            return curr != rhs.curr;
+        }
+
+        private:
+        void enter_block() {
+            // only the single remaining node can be empty
+            while (node != nullptr && node->empty()) {
+                node = node->next;
+            }
+            curr = node != nullptr ? node->slots() + node->begin : nullptr;
+            last = node != nullptr ? node->slots() + node->end : nullptr;
+        }
+    };
+
+    iterator begin() {
+        return iterator(head);
+    }
+
+    iterator end() {
+        return iterator();
+    }
+
+    private:
+    Node* create_node(uint32_t position) {
+        Node *node = node_traits::allocate(alloc, 1);
+        node_traits::construct(alloc, node);
+        node->begin = node->end = position;
+        return node;
+    }
+
+    void destroy_node(Node *node) {
+        node_traits::destroy(alloc, node);
+        node_traits::deallocate(alloc, node, 1);
+    }
+};
+
+// link embedded in the element type of an IntrusiveList. an element can
+// sit in one list per Tag at a time by deriving from several hooks
+template <typename Tag = void>
+struct IntrusiveListHook {
+    IntrusiveListHook *next{nullptr};
+};
+
+// singly linked list threaded through hooks inside the elements, which it
+// does not own: linking and unlinking never allocate or move a T, so the
+// elements can live in a pool of their own. whole lists are spliced in
+// O(1), and sort is a stable merge sort that only relinks the hooks
+template <typename T, typename Tag = void>
+class IntrusiveList {
+    using hook = IntrusiveListHook<Tag>;
+
+    static_assert(std::is_base_of_v<hook, T>, "T must derive from IntrusiveListHook<Tag>");
+
+    hook *head{nullptr};
+    hook *tail{nullptr};
+    size_t length{0};
+
+    public:
+    using value_type = T;
+
+    IntrusiveList() {}
+
+    IntrusiveList(const IntrusiveList&) = delete;
+
+    IntrusiveList(IntrusiveList&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    IntrusiveList& operator = (const IntrusiveList&) = delete;
+    IntrusiveList& operator = (IntrusiveList&& rhs) noexcept {
+        head = rhs.head;
+        tail = rhs.tail;
+        length = rhs.length;
+        rhs.clear();
+        return *this;
+    }
+
+    auto size() const {
+        return length;
+    }
+
+    auto empty() const {
+        return length == 0;
+    }
+
+    // forgets the elements, they stay where they are
+    void clear() {
+        head = tail = nullptr;
+        length = 0;
+    }
+
+    T& peek() {
+        assert(head != nullptr);
+        return value_of(head);
+    }
+
+    void add(T& value) {
+        hook *node = &value;
+        node->next = nullptr;
+        if (tail == nullptr) {
+            head = tail = node;
+        } else {
+            tail->next = node;
+            tail = node;
+        }
+
+        ++length;
+    }
+
+    T& remove() {
+        assert(head != nullptr);
+        hook *node = head;
+        head = head->next;
+        if (head == nullptr) {
+            tail = nullptr;
+        }
+
+        node->next = nullptr;
+        --length;
+
+        return value_of(node);
+    }
+
+    void push(T& value) {
+        hook *node = &value;
+        node->next = head;
+        head = node;
+        if (tail == nullptr) {
+            tail = node;
+        }
+
+        ++length;
+    }
+
+    T& pop() {
+        return remove();
+    }
+
+    // moves every element of other to the back of this list
+    void splice(IntrusiveList& other) {
+        if (other.head == nullptr) {
+            return;
+        }
+
+        if (tail == nullptr) {
+            head = other.head;
+        } else {
+            tail->next = other.head;
+        }
+        tail = other.tail;
+        length += other.length;
+        other.clear();
+    }
+
+    // moves every element of other to the front of this list
+    void splice_front(IntrusiveList& other) {
+        if (other.head == nullptr) {
+            return;
+        }
+
+        other.tail->next = head;
+        head = other.head;
+        if (tail == nullptr) {
+            tail = other.tail;
+        }
+        length += other.length;
+        other.clear();
+    }
+
+    // stable bottom-up merge sort. runs of 2^i elements are merged like a
+    // binary counter, so the only extra space is one run per bit of size()
+    template <typename Compare = std::less<T>>
+    void sort(Compare less = Compare()) {
+        if (length < 2) {
+            return;
+        }
+
+        chain runs[sizeof(size_t) * 8] = {};
+        size_t used = 0;
+
+        while (head != nullptr) {
+            chain run{head, head};
+            head = head->next;
+            run.head->next = nullptr;
+
+            // runs[i] holds older elements than run, so it goes first
+            size_t i = 0;
+            for (; i != used && runs[i].head != nullptr; ++i) {
+                run = merge(runs[i], run, less);
+                runs[i] = chain{};
+            }
+            if (i == used) {
+                ++used;
+            }
+            runs[i] = run;
+        }
+
+        chain sorted{};
+        for (size_t i = 0; i != used; ++i) {
+            if (runs[i].head != nullptr) {
+                sorted = sorted.head == nullptr ? runs[i] : merge(runs[i], sorted, less);
+            }
+        }
+
+        head = sorted.head;
+        tail = sorted.tail;
+    }
+
+    class iterator {
+        hook *node{nullptr};
+
+        public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        iterator() {}
+
+        explicit iterator(hook *node): node(node) {}
+
+        T& operator * () const {
+            return value_of(node);
+        }
+
+        T* operator -> () const {
+            return &value_of(node);
+        }
+
+        iterator& operator ++ () {
+            node = node->next;
+            return *this;
+        }
+
+        iterator operator ++ (int) {
+            auto copy = *this;
+            node = node->next;
+            return copy;
+        }
+
+        bool operator == (const iterator& rhs) const {
+            return node == rhs.node;
+        }
+
+        bool operator != (const iterator& rhs) const {
+            return node != rhs.node;
+        }
+    };
+
+    iterator begin() {
+        return iterator(head);
+    }
+
+    iterator end() {
+        return iterator();
+    }
+
+    private:
+    static T& value_of(hook *node) {
+        return *static_cast<T *>(node);
+    }
+
+    // null-terminated run of linked elements
+    struct chain {
+        hook *head{nullptr};
+        hook *tail{nullptr};
+    };
+
+    // merges two sorted chains, ties are taken from first
+    template <typename Compare>
+    static chain merge(chain first, chain second, Compare& less) {
+        hook start;
+        hook *last = &start;
+        hook *a = first.head;
+        hook *b = second.head;
+        while (a != nullptr && b != nullptr) {
+            if (less(value_of(b), value_of(a))) {
+                last->next = b;
+                b = b->next;
+            } else {
+                last->next = a;
+                a = a->next;
+            }
+            last = last->next;
+        }
+        last->next = a != nullptr ? a : b;
+        return chain{start.next, a != nullptr ? first.tail : second.tail};
+    }
+};
+
+// unbounded multi-producer/multi-consumer FIFO queue (Michael & Scott).
+// same node shape as SinglyLinkedList, but head always points to a dummy
+// node whose value was already taken, and both ends are advanced with CAS.
+// dequeued dummies are retired through epoch reclamation, so a node is
+// never freed while another thread may still be reading it
+template <typename T>
+class ConcurrentLinkedQueue {
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() {
+            return reinterpret_cast<T*>(storage);
+        }
+    };
+
+    alignas(64) std::atomic<Node*> head;
+    alignas(64) std::atomic<Node*> tail;
+
+    public:
+    using value_type = T;
+
+    ConcurrentLinkedQueue() {
+        auto *dummy = new Node;
+        head.store(dummy);
+        tail.store(dummy);
+    }
+
+    ConcurrentLinkedQueue(const ConcurrentLinkedQueue&) = delete;
+    ConcurrentLinkedQueue& operator = (const ConcurrentLinkedQueue&) = delete;
+
+    // must not race with other operations
+    ~ConcurrentLinkedQueue() {
+        Node *node = head.load();
+        Node *next = node->next.load();
+        delete node;
+
+        while (next != nullptr) {
+            node = next;
+            next = node->next.load();
+            node->value()->~T();
+            delete node;
+        }
+    }
+
+    // approximate when called concurrently
+    bool empty() const {
+        epoch_guard guard;
+        return head.load()->next.load() == nullptr;
+    }
+
+    template <typename U>
+    void add(U&& value) {
+        auto *node = new Node;
+        new (node->storage) T(std::move(value));
+
+        epoch_guard guard;
+        while (true) {
+            Node *last = tail.load(std::memory_order_acquire);
+            Node *next = last->next.load(std::memory_order_acquire);
+
+            if (last != tail.load(std::memory_order_acquire)) {
+                continue;
+            }
+
+            if (next != nullptr) {
+                // tail is lagging, help the other producer
+                tail.compare_exchange_weak(last, next);
+                continue;
+            }
+
+            if (last->next.compare_exchange_weak(next, node)) {
+                tail.compare_exchange_strong(last, node);
+                return;
+            }
+        }
+    }
+
+    bool try_remove(T& out) {
+        epoch_guard guard;
+        while (true) {
+            Node *first = head.load(std::memory_order_acquire);
+            Node *last = tail.load(std::memory_order_acquire);
+            Node *next = first->next.load(std::memory_order_acquire);
+
+            if (first != head.load(std::memory_order_acquire)) {
+                continue;
+            }
+
+            if (next == nullptr) {
+                return false;
+            }
+
+            if (first == last) {
+                tail.compare_exchange_weak(last, next);
+                continue;
+            }
+
+            if (head.compare_exchange_weak(first, next)) {
+                // next is the new dummy, only the winner of the CAS touches its value
+                out = std::move(*next->value());
+                next->value()->~T();
+                epoch_reclaimer::instance().retire(first);
+                return true;
+            }
+        }
+    }
+};
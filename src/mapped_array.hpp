@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "array.hpp"
+
+// raw storage like array<T>, but the slots live in a shared mapping of a
+// file. the kernel pages them in and out, so the data may be larger than
+// RAM, and reallocate resizes the file and remaps it without copying a
+// byte: mremap moves page table entries, not pages. the file starts with
+// a small header, so opening an existing file is a single mmap with no
+// parse step. only for trivially copyable T, whose bytes are the object
+template <typename T>
+class mapped_array {
+    static_assert(std::is_trivially_copyable_v<T>, "mapped objects are stored as bytes");
+
+    struct header {
+        uint64_t magic;
+        uint32_t element_size;
+        uint32_t capacity;
+        uint32_t length; // kept for the owning container
+    };
+
+    // the data starts on its own page so madvise ranges line up
+    static constexpr size_t header_size = 4096;
+    static constexpr uint64_t file_magic = 0x7961727261706d6dULL;
+
+    static_assert(alignof(T) <= header_size, "slots must be aligned within the mapping");
+
+    int fd{-1};
+    char *base{nullptr};
+    size_t mapped{0};
+    uint32_t length{0};
+
+    public:
+    // opens path, creating it with `length` slots when it doesn't exist.
+    // an existing file keeps its own capacity and stored length. a file
+    // longer than its header says is one whose owner died in the middle of
+    // a reallocate; it is valid and cut back to the header's capacity
+    mapped_array(const std::string& path, uint32_t length) {
+        assert(length != 0);
+
+        // only a failed open gives its resources back, a live array that
+        // fails to resize or sync stays as it was
+        try {
+            open_file(path, length);
+        } catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    ~mapped_array() {
+        release();
+    }
+
+    mapped_array(mapped_array&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    mapped_array& operator = (mapped_array&& rhs) noexcept {
+        std::swap(fd, rhs.fd);
+        std::swap(base, rhs.base);
+        std::swap(mapped, rhs.mapped);
+        std::swap(length, rhs.length);
+        return *this;
+    }
+
+    mapped_array(const mapped_array&) = delete;
+    mapped_array& operator = (const mapped_array&) = delete;
+
+    T& operator [] (size_t idx) {
+        return data()[idx];
+    }
+
+    T* data() {
+        return reinterpret_cast<T*>(base + header_size);
+    }
+
+    uint32_t size() const {
+        return length;
+    }
+
+    // number of live objects, stored in the file for the owner
+    uint32_t& stored_length() {
+        return meta()->length;
+    }
+
+    uint32_t stored_length() const {
+        return const_cast<mapped_array *>(this)->meta()->length;
+    }
+
+    template <typename... Args>
+    T& construct(size_t idx, Args&&... args) {
+        return *new (data() + idx) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(size_t) {}
+
+    // grows or shrinks the file and its mapping, the mapping may move.
+    // the file is never shorter than the header's capacity, so a process
+    // that dies at any step leaves a file the constructor accepts: a grow
+    // extends the file before the header, a shrink lowers the header first.
+    // on an error (a full disk) the array keeps its old mapping and
+    // capacity; a failed grow may leave the file longer, which is valid
+    void reallocate(uint32_t new_length) {
+        assert(new_length != 0);
+        size_t new_bytes = bytes(new_length);
+
+        if (new_bytes > mapped) {
+            resize_file(new_bytes);
+            remap(new_bytes);
+            meta()->capacity = new_length;
+            length = new_length;
+        } else {
+            meta()->capacity = new_length;
+            try {
+                remap(new_bytes);
+            } catch (...) {
+                meta()->capacity = length;
+                throw;
+            }
+            length = new_length;
+            resize_file(new_bytes);
+        }
+    }
+
+    // writes dirty pages back to the file and waits for it
+    void flush() {
+        if (::msync(base, bytes(length), MS_SYNC) != 0) {
+            fail("msync");
+        }
+    }
+
+    // passes an madvise hint (MADV_SEQUENTIAL, MADV_WILLNEED, ...) for
+    // slots [first, first + count)
+    void advise(int advice, size_t first, size_t count) {
+        size_t begin = header_size + first * sizeof(T);
+        size_t end = header_size + (first + count) * sizeof(T);
+        size_t page = size_t(::sysconf(_SC_PAGESIZE));
+        begin -= begin % page;
+        if (end > begin && ::madvise(base + begin, end - begin, advice) != 0) {
+            fail("madvise");
+        }
+    }
+
+    void advise(int advice) {
+        advise(advice, 0, length);
+    }
+
+    private:
+    void open_file(const std::string& path, uint32_t length) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            fail("open");
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            fail("fstat");
+        }
+
+        if (st.st_size == 0) {
+            resize_file(bytes(length));
+            map(bytes(length));
+            *meta() = header{file_magic, uint32_t(sizeof(T)), length, 0};
+        } else {
+            if (size_t(st.st_size) < header_size) {
+                fail("not a mapped array", EINVAL);
+            }
+            map(size_t(st.st_size));
+            if (meta()->magic != file_magic || meta()->element_size != sizeof(T) || meta()->capacity == 0
+                || bytes(meta()->capacity) > size_t(st.st_size) || meta()->length > meta()->capacity) {
+                fail("not a mapped array of this type", EINVAL);
+            }
+            if (bytes(meta()->capacity) != size_t(st.st_size)) {
+                remap(bytes(meta()->capacity));
+                resize_file(mapped);
+            }
+        }
+        this->length = meta()->capacity;
+    }
+
+    static size_t bytes(uint32_t length) {
+        return header_size + size_t(length) * sizeof(T);
+    }
+
+    header* meta() {
+        return reinterpret_cast<header*>(base);
+    }
+
+    void map(size_t size) {
+        void *ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED) {
+            fail("mmap");
+        }
+        base = static_cast<char*>(ptr);
+        mapped = size;
+    }
+
+    void remap(size_t size) {
+        void *ptr = ::mremap(base, mapped, size, MREMAP_MAYMOVE);
+        if (ptr == MAP_FAILED) {
+            fail("mremap");
+        }
+        base = static_cast<char*>(ptr);
+        mapped = size;
+    }
+
+    void resize_file(size_t size) {
+        if (::ftruncate(fd, off_t(size)) != 0) {
+            fail("ftruncate");
+        }
+    }
+
+    [[noreturn]] static void fail(const char *what, int error = errno) {
+        throw std::system_error(error, std::generic_category(), what);
+    }
+
+    void release() {
+        if (base != nullptr) {
+            ::munmap(base, mapped);
+            base = nullptr;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+};
+
+// ArrayStack of trivially copyable elements kept in a file through
+// mapped_array. growing never holds two copies of the data, and the
+// length lives in the file, so reopening the same path brings the stack
+// back in the time of one mmap
+template <typename T, typename Policy = geometric_growth<>>
+class MappedArrayStack {
+    mapped_array<T> _array;
+
+    public:
+    using value_type = T;
+    using policy_type = Policy;
+
+    explicit MappedArrayStack(const std::string& path, uint32_t capacity = 4): _array(path, capacity) {}
+
+    uint32_t size() const {
+        return _array.stored_length();
+    }
+
+    uint32_t capacity() const {
+        return _array.size();
+    }
+
+    T& get(size_t idx) {
+        return _array[idx];
+    }
+
+    T set(size_t idx, const T& val) {
+        T tmp = _array[idx];
+        _array[idx] = val;
+        return tmp;
+    }
+
+    void add(size_t idx, T val) {
+        uint32_t length = size();
+        if (length + 1 > _array.size()) {
+            _array.reallocate(Policy::grow(_array.size(), length + 1));
+        }
+
+        T *first = _array.data();
+        std::memmove(static_cast<void*>(first + idx + 1), first + idx, (length - idx) * sizeof(T));
+        _array.construct(idx, std::move(val));
+        _array.stored_length() = length + 1;
+    }
+
+    T remove(size_t idx) {
+        uint32_t length = size();
+        T *first = _array.data();
+        T tmp = first[idx];
+        std::memmove(static_cast<void*>(first + idx), first + idx + 1, (length - idx - 1) * sizeof(T));
+        _array.stored_length() = --length;
+
+        uint32_t capacity = Policy::shrink(_array.size(), length);
+        if (capacity != _array.size()) {
+            _array.reallocate(capacity);
+        }
+
+        return tmp;
+    }
+
+    void reserve(uint32_t capacity) {
+        if (capacity > _array.size()) {
+            _array.reallocate(capacity);
+        }
+    }
+
+    void shrink_to_fit() {
+        uint32_t capacity = std::max(1U, size());
+        if (capacity != _array.size()) {
+            _array.reallocate(capacity);
+        }
+    }
+
+    void flush() {
+        _array.flush();
+    }
+
+    void advise(int advice) {
+        _array.advise(advice, 0, size());
+    }
+};
@@ -0,0 +1,216 @@
+#include <iostream>
+#include <cassert>
+#include <atomic>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "parallel.hpp"
+
+static tree_node<int>* build_tree(int lo, int hi) {
+    if (lo >= hi) {
+        return nullptr;
+    }
+
+    int mid = lo + (hi - lo) / 2;
+    return new tree_node<int>(mid, build_tree(lo, mid), build_tree(mid + 1, hi));
+}
+
+// right-leaning chain, the worst shape for subtree splitting
+static tree_node<int>* build_chain(int n) {
+    tree_node<int> *root = nullptr;
+    for (int i = n - 1; i >= 0; --i) {
+        root = new tree_node<int>(i, nullptr, root);
+    }
+    return root;
+}
+
+static void delete_tree(tree_node<int> *root) {
+    recursive_postorder(root, [](tree_node<int> *node) { delete node; });
+}
+
+struct counting_task : pool_task {
+    std::atomic<int> *runs;
+
+    explicit counting_task(std::atomic<int> *runs): pool_task(&counting_task::run), runs(runs) {}
+
+    static void run(pool_task *self) {
+        static_cast<counting_task *>(self)->runs->fetch_add(1);
+    }
+};
+
+void test_chase_lev_deque() {
+    std::atomic<int> runs{0};
+    std::deque<counting_task> tasks;
+    for (size_t i = 0; i != 1000; ++i) {
+        tasks.emplace_back(&runs);
+    }
+
+    // owner end is LIFO, thief end is FIFO, and the buffer grows past 256
+    chase_lev_deque deque;
+    for (auto& task : tasks) {
+        deque.push(&task);
+    }
+    assert(deque.steal() == &tasks[0]);
+    assert(deque.pop() == &tasks[999]);
+    for (size_t i = 998; i != 0; --i) {
+        assert(deque.pop() == &tasks[i]);
+    }
+    assert(deque.pop() == nullptr);
+    assert(deque.steal() == nullptr);
+
+    // the owner pushes and pops while thieves steal: every task is taken once
+    std::atomic<bool> done{false};
+    std::vector<std::thread> thieves;
+    for (size_t t = 0; t != 3; ++t) {
+        thieves.emplace_back([&] {
+            while (!done.load()) {
+                if (pool_task *task = deque.steal()) {
+                    task->execute(task);
+                }
+            }
+        });
+    }
+
+    for (size_t round = 0; round != 100; ++round) {
+        for (size_t i = 0; i != tasks.size(); ++i) {
+            deque.push(&tasks[i]);
+            if (i & 1) {
+                if (pool_task *own = deque.pop()) {
+                    own->execute(own);
+                }
+            }
+        }
+        while (pool_task *own = deque.pop()) {
+            own->execute(own);
+        }
+        while (runs.load() != int((round + 1) * tasks.size())) {
+            std::this_thread::yield();
+        }
+    }
+    done.store(true);
+    for (auto& t : thieves) {
+        t.join();
+    }
+    assert(runs.load() == 100 * 1000);
+
+    std::cout << "test_chase_lev_deque > ok" << std::endl;
+}
+
+void test_parallel_for_each(size_t threads) {
+    work_stealing_pool pool(threads);
+    const int n = 100000;
+
+    for (int count : {n, n / 10}) {
+        auto *root = count == n ? build_tree(0, count) : build_chain(count);
+        std::vector<std::atomic<int>> seen(count);
+        for (uint32_t cutoff : {0u, 3u, default_parallel_cutoff(pool), 64u}) {
+            for (auto& s : seen) {
+                s.store(0);
+            }
+            parallel_for_each(pool, root, [&seen](tree_node<int> *node) { seen[node->value].fetch_add(1); }, cutoff);
+            for (auto& s : seen) {
+                assert(s.load() == 1);
+            }
+        }
+        delete_tree(root);
+    }
+
+    parallel_for_each(pool, (tree_node<int> *)nullptr, [](tree_node<int> *) { assert(false); });
+
+    std::cout << "test_parallel_for_each threads: " << threads << " > ok" << std::endl;
+}
+
+void test_parallel_reduce(size_t threads) {
+    work_stealing_pool pool(threads);
+
+    auto *root = build_tree(0, 100000);
+    int64_t sum = parallel_reduce(pool, root, int64_t(0),
+                                  [](tree_node<int> *node) { return int64_t(node->value); },
+                                  [](int64_t a, int64_t b) { return a + b; });
+    assert(sum == int64_t(100000) * 99999 / 2);
+
+    // floating point addition is only associative up to rounding, so any
+    // difference in grouping would show up in the low bits
+    auto float_sum = [&](uint32_t cutoff) {
+        return parallel_reduce(pool, root, 0.0,
+                               [](tree_node<int> *node) { return 1.0 / (node->value + 1); },
+                               [](double a, double b) { return a + b; }, cutoff);
+    };
+    double expected = float_sum(0);
+    for (size_t i = 0; i != 10; ++i) {
+        assert(float_sum(default_parallel_cutoff(pool)) == expected);
+        assert(float_sum(12) == expected);
+    }
+    delete_tree(root);
+
+    // non-commutative reductions come out in inorder
+    root = build_tree(0, 500);
+    std::string joined = parallel_reduce(pool, root, std::string(),
+                                         [](tree_node<int> *node) { return std::to_string(node->value) + ","; },
+                                         [](std::string a, const std::string& b) { return a += b; }, 4);
+    std::string inorder;
+    for (int i = 0; i != 500; ++i) {
+        inorder += std::to_string(i) + ",";
+    }
+    assert(joined == inorder);
+    delete_tree(root);
+
+    std::cout << "test_parallel_reduce threads: " << threads << " > ok" << std::endl;
+}
+
+// a throwing visitor reaches the caller after every forked task is joined,
+// and the pool keeps working afterwards
+void test_parallel_exceptions(size_t threads) {
+    work_stealing_pool pool(threads);
+    const int n = 100000;
+    auto *root = build_tree(0, n);
+
+    // thrown at the root, deep in a forked left subtree, and below the cutoff
+    for (int bad : {n / 2, n / 8, 3}) {
+        std::atomic<int> visited{0};
+        bool caught = false;
+        try {
+            parallel_for_each(pool, root, [&visited, bad](tree_node<int> *node) {
+                if (node->value == bad) {
+                    throw std::runtime_error("visitor failed");
+                }
+                visited.fetch_add(1);
+            });
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        assert(caught && visited.load() < n);
+
+        caught = false;
+        try {
+            parallel_reduce(pool, root, int64_t(0), [bad](tree_node<int> *node) {
+                if (node->value == bad) {
+                    throw std::runtime_error("map failed");
+                }
+                return int64_t(node->value);
+            }, [](int64_t a, int64_t b) { return a + b; });
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        assert(caught);
+    }
+
+    std::atomic<int> visited{0};
+    parallel_for_each(pool, root, [&visited](tree_node<int> *) { visited.fetch_add(1); });
+    assert(visited.load() == n);
+    delete_tree(root);
+
+    std::cout << "test_parallel_exceptions threads: " << threads << " > ok" << std::endl;
+}
+
+void _main() {
+    std::cout << "parallel traversal test" << std::endl;
+    test_chase_lev_deque();
+    for (size_t threads : {1, 2, 4}) {
+        test_parallel_for_each(threads);
+        test_parallel_reduce(threads);
+        test_parallel_exceptions(threads);
+    }
+}
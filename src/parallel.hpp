@@ -0,0 +1,425 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "tree.hpp"
+
+// unit of work for the pool. tasks live in the frame of the code that
+// spawned them, which always joins them before returning, also when it
+// throws. an exception thrown by the task is kept for the joiner
+struct pool_task {
+    void (*execute)(pool_task *);
+    std::atomic<bool> done{false};
+    std::exception_ptr error;
+
+    explicit pool_task(void (*execute)(pool_task *)): execute(execute) {}
+};
+
+// Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli: "Correct
+// and efficient work-stealing for weak memory models"). the owner pushes
+// and pops at the bottom, thieves steal from the top. the buffer grows
+// by doubling; retired buffers are kept until the deque dies because a
+// thief may still be reading one
+class chase_lev_deque {
+    struct buffer {
+        int64_t capacity;
+        std::unique_ptr<std::atomic<pool_task *>[]> slots;
+
+        explicit buffer(int64_t capacity): capacity(capacity), slots(new std::atomic<pool_task *>[capacity]) {}
+
+        pool_task* get(int64_t i) const {
+            return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, pool_task *task) {
+            slots[i & (capacity - 1)].store(task, std::memory_order_relaxed);
+        }
+    };
+
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::atomic<buffer *> active;
+    std::vector<std::unique_ptr<buffer>> buffers;
+
+    public:
+    chase_lev_deque(int64_t capacity = 256) {
+        buffers.emplace_back(new buffer(capacity));
+        active.store(buffers.back().get());
+    }
+
+    // owner only
+    void push(pool_task *task) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        buffer *a = active.load(std::memory_order_relaxed);
+
+        if (b - t > a->capacity - 1) {
+            buffers.emplace_back(new buffer(a->capacity * 2));
+            buffer *grown = buffers.back().get();
+            for (int64_t i = t; i != b; ++i) {
+                grown->put(i, a->get(i));
+            }
+            active.store(grown, std::memory_order_release);
+            a = grown;
+        }
+
+        // release store rather than fence + relaxed: same ordering, and
+        // visible to thread sanitizers
+        a->put(b, task);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // owner only
+    pool_task* pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        buffer *a = active.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        pool_task *task = a->get(b);
+        if (t == b) {
+            // last element, race against thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                task = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // any thread
+    pool_task* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return nullptr;
+        }
+
+        buffer *a = active.load(std::memory_order_acquire);
+        pool_task *task = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return task;
+    }
+};
+
+// fork-join pool: one deque per worker, the thread calling run() acts as
+// worker 0. idle workers steal from random victims; a worker waiting in
+// join() keeps executing tasks, so waiting never blocks progress
+class work_stealing_pool {
+    struct worker {
+        chase_lev_deque deque;
+        uint64_t seed;
+    };
+
+    std::vector<std::unique_ptr<worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex run_mutex;
+    std::mutex idle_mutex;
+    std::condition_variable idle;
+    std::atomic<bool> running{false};
+    std::atomic<bool> stopping{false};
+
+    static worker*& current() {
+        thread_local worker *self = nullptr;
+        return self;
+    }
+
+    public:
+    explicit work_stealing_pool(size_t thread_count = std::thread::hardware_concurrency()) {
+        thread_count = std::max<size_t>(1, thread_count);
+        for (size_t i = 0; i != thread_count; ++i) {
+            workers.emplace_back(new worker{chase_lev_deque(), 0x9e3779b97f4a7c15ULL * (i + 1)});
+        }
+        for (size_t i = 1; i != thread_count; ++i) {
+            threads.emplace_back([this, i] { loop(workers[i].get()); });
+        }
+    }
+
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator = (const work_stealing_pool&) = delete;
+
+    ~work_stealing_pool() {
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            stopping.store(true);
+        }
+        idle.notify_all();
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    // runs func on the calling thread with the pool's workers helping.
+    // not reentrant: calling it from inside a task would deadlock, tasks
+    // fork with spawn/join instead
+    template <typename Func>
+    auto run(Func func) {
+        assert(current() == nullptr && "run() called from inside a pool task");
+        std::lock_guard<std::mutex> run_lock(run_mutex);
+        current() = workers[0].get();
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            running.store(true);
+        }
+        idle.notify_all();
+
+        struct finish {
+            work_stealing_pool *pool;
+            ~finish() {
+                pool->running.store(false);
+                current() = nullptr;
+            }
+        } guard{this};
+
+        return func();
+    }
+
+    // only from inside run()
+    void spawn(pool_task& task) {
+        current()->deque.push(&task);
+    }
+
+    void join(pool_task& task) {
+        worker *self = current();
+        while (!task.done.load(std::memory_order_acquire)) {
+            pool_task *other = self->deque.pop();
+            if (other == nullptr) {
+                other = steal(self);
+            }
+
+            if (other != nullptr) {
+                execute(other);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    private:
+    // a throw must not escape a worker thread, the joiner rethrows it
+    static void execute(pool_task *task) {
+        try {
+            task->execute(task);
+        } catch (...) {
+            task->error = std::current_exception();
+        }
+        task->done.store(true, std::memory_order_release);
+    }
+
+    pool_task* steal(worker *self) {
+        // xorshift pick of the first victim, then sweep the rest
+        self->seed ^= self->seed << 13;
+        self->seed ^= self->seed >> 7;
+        self->seed ^= self->seed << 17;
+        size_t start = self->seed % workers.size();
+
+        for (size_t i = 0; i != workers.size(); ++i) {
+            worker *victim = workers[(start + i) % workers.size()].get();
+            if (victim != self) {
+                if (pool_task *task = victim->deque.steal()) {
+                    return task;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void loop(worker *self) {
+        current() = self;
+        while (true) {
+            if (!running.load()) {
+                std::unique_lock<std::mutex> lock(idle_mutex);
+                idle.wait(lock, [this] { return running.load() || stopping.load(); });
+                if (stopping.load()) {
+                    return;
+                }
+            }
+
+            pool_task *task = self->deque.pop();
+            if (task == nullptr) {
+                task = steal(self);
+            }
+
+            if (task != nullptr) {
+                execute(task);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
+
+// rethrows the exception of the task's own work, else that of its forked child
+inline void rethrow_first(const std::exception_ptr& own, const std::exception_ptr& child) {
+    if (own) {
+        std::rethrow_exception(own);
+    }
+    if (child) {
+        std::rethrow_exception(child);
+    }
+}
+
+// depth below which subtrees run sequentially: enough tasks for every
+// worker to steal a few times without paying a spawn per node
+inline uint32_t default_parallel_cutoff(const work_stealing_pool& pool) {
+    uint32_t depth = 4;
+    for (size_t n = pool.size(); n > 1; n >>= 1) {
+        ++depth;
+    }
+    return depth;
+}
+
+// applies func to every node once, in no particular order. func runs
+// concurrently on different nodes. left subtrees are forked and right
+// subtrees continue on the current worker until the cutoff depth
+template <typename T, typename Func>
+void parallel_for_each(work_stealing_pool& pool, tree_node<T> *root, Func func, uint32_t cutoff) {
+    struct subtree_task : pool_task {
+        work_stealing_pool *pool;
+        tree_node<T> *root;
+        uint32_t depth;
+        uint32_t cutoff;
+        Func *func;
+
+        subtree_task(work_stealing_pool *pool, tree_node<T> *root, uint32_t depth, uint32_t cutoff, Func *func)
+            : pool_task(&subtree_task::run), pool(pool), root(root), depth(depth), cutoff(cutoff), func(func) {}
+
+        static void run(pool_task *self) {
+            auto *task = static_cast<subtree_task *>(self);
+            visit_subtree(*task->pool, task->root, task->depth, task->cutoff, *task->func);
+        }
+
+        static void visit_subtree(work_stealing_pool& pool, tree_node<T> *node, uint32_t depth, uint32_t cutoff, Func& func) {
+            if (node == nullptr) {
+                return;
+            }
+            if (depth >= cutoff) {
+                recursive_preorder(node, func);
+                return;
+            }
+
+            // left must be joined before this frame unwinds, since a thief
+            // may be running it; the first exception wins
+            subtree_task left(&pool, node->left, depth + 1, cutoff, &func);
+            if (node->left != nullptr) {
+                pool.spawn(left);
+            }
+            std::exception_ptr error;
+            try {
+                func(node);
+                visit_subtree(pool, node->right, depth + 1, cutoff, func);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            if (node->left != nullptr) {
+                pool.join(left);
+            }
+            rethrow_first(error, left.error);
+        }
+    };
+
+    pool.run([&] {
+        subtree_task::visit_subtree(pool, root, 0, cutoff, func);
+        return 0;
+    });
+}
+
+template <typename T, typename Func>
+void parallel_for_each(work_stealing_pool& pool, tree_node<T> *root, Func func) {
+    parallel_for_each(pool, root, std::move(func), default_parallel_cutoff(pool));
+}
+
+// map-reduce over the tree in inorder:
+//   result(node) = reduce(reduce(result(left), map(node)), result(right))
+// with `identity` for empty subtrees. the combine tree is fixed by the
+// shape of the tree, not by the schedule or the cutoff, so an associative
+// reduce gives the same result, bit for bit, for any number of threads
+template <typename R, typename T, typename Map, typename Reduce>
+R parallel_reduce(work_stealing_pool& pool, tree_node<T> *root, R identity, Map map, Reduce reduce, uint32_t cutoff) {
+    struct context {
+        work_stealing_pool *pool;
+        const R *identity;
+        Map *map;
+        Reduce *reduce;
+        uint32_t cutoff;
+    };
+
+    struct subtree_task : pool_task {
+        const context *ctx;
+        tree_node<T> *root;
+        uint32_t depth;
+        R result;
+
+        subtree_task(const context *ctx, tree_node<T> *root, uint32_t depth)
+            : pool_task(&subtree_task::run), ctx(ctx), root(root), depth(depth), result(*ctx->identity) {}
+
+        static void run(pool_task *self) {
+            auto *task = static_cast<subtree_task *>(self);
+            task->result = reduce_subtree(*task->ctx, task->root, task->depth);
+        }
+
+        static R sequential(const context& ctx, tree_node<T> *node) {
+            if (node == nullptr) {
+                return *ctx.identity;
+            }
+            R left = sequential(ctx, node->left);
+            R mid = (*ctx.map)(node);
+            R right = sequential(ctx, node->right);
+            return (*ctx.reduce)((*ctx.reduce)(std::move(left), std::move(mid)), std::move(right));
+        }
+
+        static R reduce_subtree(const context& ctx, tree_node<T> *node, uint32_t depth) {
+            if (node == nullptr) {
+                return *ctx.identity;
+            }
+            if (depth >= ctx.cutoff) {
+                return sequential(ctx, node);
+            }
+
+            subtree_task left(&ctx, node->left, depth + 1);
+            ctx.pool->spawn(left);
+            std::exception_ptr error;
+            R mid = *ctx.identity;
+            R right = *ctx.identity;
+            try {
+                mid = (*ctx.map)(node);
+                right = reduce_subtree(ctx, node->right, depth + 1);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            ctx.pool->join(left);
+            rethrow_first(error, left.error);
+            return (*ctx.reduce)((*ctx.reduce)(std::move(left.result), std::move(mid)), std::move(right));
+        }
+    };
+
+    context ctx{&pool, &identity, &map, &reduce, cutoff};
+    return pool.run([&] { return subtree_task::reduce_subtree(ctx, root, 0); });
+}
+
+template <typename R, typename T, typename Map, typename Reduce>
+R parallel_reduce(work_stealing_pool& pool, tree_node<T> *root, R identity, Map map, Reduce reduce) {
+    return parallel_reduce(pool, root, std::move(identity), std::move(map), std::move(reduce), default_parallel_cutoff(pool));
+}
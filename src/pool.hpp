@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// fixed-size object pool usable as a standard allocator
+// single objects are carved out of large slabs and recycled through an
+// intrusive free list, so steady-state allocate/deallocate never hits the heap.
+// slabs are only returned to the system by release() or the destructor
+template <typename T, size_t SlabSize = 64>
+class PoolAllocator {
+    static_assert(SlabSize != 0, "slab must hold at least one object");
+
+    union Slot {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct Slab {
+        Slab *next;
+        Slot slots[SlabSize];
+    };
+
+    Slab *slabs{nullptr};
+    Slot *free_list{nullptr};
+    size_t carved{SlabSize};
+    size_t slab_count{0};
+
+    public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+    // owner may skip per-object deallocate and drop every slab at once
+    using bulk_release = std::true_type;
+
+    template <typename U>
+    struct rebind {
+        using other = PoolAllocator<U, SlabSize>;
+    };
+
+    PoolAllocator() noexcept {}
+
+    // pools are never shared, a copy starts empty
+    PoolAllocator(const PoolAllocator&) noexcept {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, SlabSize>&) noexcept {}
+
+    PoolAllocator(PoolAllocator&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    PoolAllocator& operator = (const PoolAllocator&) = delete;
+
+    PoolAllocator& operator = (PoolAllocator&& rhs) noexcept {
+        if (this != &rhs) {
+            release();
+            slabs = rhs.slabs;
+            free_list = rhs.free_list;
+            carved = rhs.carved;
+            slab_count = rhs.slab_count;
+            rhs.slabs = nullptr;
+            rhs.free_list = nullptr;
+            rhs.carved = SlabSize;
+            rhs.slab_count = 0;
+        }
+        return *this;
+    }
+
+    ~PoolAllocator() {
+        release();
+    }
+
+    T* allocate(size_t n) {
+        if (n != 1) {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+        }
+
+        if (free_list != nullptr) {
+            Slot *slot = free_list;
+            free_list = slot->next;
+            return reinterpret_cast<T*>(slot->storage);
+        }
+
+        if (carved == SlabSize) {
+            auto *slab = new Slab;
+            slab->next = slabs;
+            slabs = slab;
+            carved = 0;
+            ++slab_count;
+        }
+
+        return reinterpret_cast<T*>(slabs->slots[carved++].storage);
+    }
+
+    void deallocate(T *ptr, size_t n) noexcept {
+        if (n != 1) {
+            ::operator delete(ptr, std::align_val_t(alignof(T)));
+            return;
+        }
+
+        auto *slot = reinterpret_cast<Slot*>(ptr);
+        slot->next = free_list;
+        free_list = slot;
+    }
+
+    // drops every slab at once, objects must already be destroyed
+    void release() noexcept {
+        while (slabs != nullptr) {
+            Slab *next = slabs->next;
+            delete slabs;
+            slabs = next;
+        }
+
+        free_list = nullptr;
+        carved = SlabSize;
+        slab_count = 0;
+    }
+
+    size_t slabs_allocated() const {
+        return slab_count;
+    }
+
+    template <typename U>
+    bool operator == (const PoolAllocator<U, SlabSize>& rhs) const noexcept {
+        return static_cast<const void*>(this) == static_cast<const void*>(&rhs);
+    }
+
+    template <typename U>
+    bool operator != (const PoolAllocator<U, SlabSize>& rhs) const noexcept {
+        return !(*this == rhs);
+    }
+};
+
+template <typename Alloc, typename = void>
+struct is_bulk_release : std::false_type {};
+
+template <typename Alloc>
+struct is_bulk_release<Alloc, std::void_t<typename Alloc::bulk_release>> : Alloc::bulk_release {};
+
+template <typename Alloc>
+constexpr bool is_bulk_release_v = is_bulk_release<Alloc>::value;
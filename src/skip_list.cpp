@@ -0,0 +1,180 @@
+#include <iostream>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "skip_list.hpp"
+
+// random inserts, erases and lookups checked against std::map
+void test_skip_list_model(size_t count) {
+    skip_list_map<int, int> map;
+    std::map<int, int> model;
+    std::mt19937 rng(23);
+
+    for (size_t i = 0; i != count; ++i) {
+        int key = int(rng() % (count / 2));
+        if (rng() % 3 == 0) {
+            assert(map.erase(key) == (model.erase(key) == 1));
+        } else {
+            assert(map.insert(key, key * 3) == model.emplace(key, key * 3).second);
+        }
+
+        int probe = int(rng() % (count / 2));
+        auto found = map.find(probe);
+        auto expected = model.find(probe);
+        assert(found.has_value() == (expected != model.end()));
+        assert(!found || *found == expected->second);
+    }
+    assert(map.size() == model.size());
+
+    auto it = model.begin();
+    map.for_each([&it](int key, int value) {
+        assert(key == it->first && value == it->second);
+        ++it;
+    });
+    assert(it == model.end());
+
+    // half open range, stopped early by the visitor
+    int from = int(count / 8);
+    int to = int(count / 4);
+    it = model.lower_bound(from);
+    size_t visited = 0;
+    map.for_each(from, to, [&](int key, int) {
+        assert(key == it->first);
+        ++it;
+        return ++visited != 100;
+    });
+    assert(visited == std::min<size_t>(100, std::distance(model.lower_bound(from), model.lower_bound(to))));
+
+    std::cout << "test_skip_list_model > size: " << map.size() << std::endl;
+}
+
+// keys and values with destructors, set interface
+void test_skip_list_strings() {
+    {
+        skip_list_map<std::string, std::string> map;
+        for (size_t i = 0; i != 2000; ++i) {
+            assert(map.insert(std::to_string(i), std::string(i % 40, 'x')));
+        }
+        assert(!map.insert("17", "again"));
+        assert(*map.find("17") == std::string(17, 'x'));
+        for (size_t i = 0; i < 2000; i += 2) {
+            assert(map.erase(std::to_string(i)));
+        }
+        assert(!map.contains("1998") && map.contains("1999"));
+        assert(map.size() == 1000);
+    }
+
+    skip_list_set<uint64_t, std::greater<uint64_t>> set;
+    for (uint64_t i = 0; i != 1000; ++i) {
+        set.insert(i);
+    }
+    uint64_t expected = 999;
+    set.for_each([&expected](uint64_t key) { assert(key == expected--); });
+    size_t in_range = 0;
+    set.for_each(500, 400, [&in_range](uint64_t) { ++in_range; });
+    assert(in_range == 100);
+
+    std::cout << "test_skip_list_strings > ok" << std::endl;
+}
+
+// every thread edits its own keys (checked exactly against a private model
+// afterwards) and fights over a small shared range, where each key's
+// successful inserts minus successful erases must end up 0 or 1. a reader
+// checks that range walks stay strictly ordered meanwhile
+void run_skip_list_stress(size_t writers, size_t ops) {
+    constexpr int shared_keys = 64;
+    skip_list_map<int, int> map;
+    std::vector<std::atomic<int>> balance(shared_keys);
+    std::vector<std::map<int, int>> models(writers);
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t t = 0; t != writers; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937 rng(static_cast<unsigned>(t));
+            auto& model = models[t];
+            for (size_t i = 0; i != ops; ++i) {
+                if (rng() % 4 == 0) {
+                    int key = int(rng() % shared_keys);
+                    if (rng() % 2 == 0) {
+                        balance[key] += map.insert(key, -1);
+                    } else {
+                        balance[key] -= map.erase(key);
+                    }
+                    continue;
+                }
+
+                int key = shared_keys + int(rng() % 1024 * writers + t);
+                if (rng() % 2 == 0) {
+                    assert(map.insert(key, int(i)) == model.emplace(key, int(i)).second);
+                } else {
+                    assert(map.erase(key) == (model.erase(key) == 1));
+                }
+                auto found = map.find(key);
+                assert(found.has_value() == (model.count(key) == 1));
+                assert(!found || *found == model[key]);
+            }
+        });
+    }
+
+    size_t walks = 0;
+    std::thread reader([&] {
+        while (!done.load()) {
+            int last = -1;
+            map.for_each(0, INT32_MAX, [&last](int key, int) {
+                assert(key > last);
+                last = key;
+            });
+            ++walks;
+        }
+    });
+
+    for (auto& t : threads) {
+        t.join();
+    }
+    done = true;
+    reader.join();
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t expected_size = 0;
+    for (int key = 0; key != shared_keys; ++key) {
+        assert(balance[key] == 0 || balance[key] == 1);
+        assert(map.contains(key) == (balance[key] == 1));
+        expected_size += balance[key];
+    }
+    for (auto& model : models) {
+        for (auto& [key, value] : model) {
+            assert(*map.find(key) == value);
+        }
+        expected_size += model.size();
+    }
+    size_t visited = 0;
+    map.for_each([&visited](int, int) { ++visited; });
+    assert(visited == expected_size && map.size() == expected_size);
+
+    std::cout << "skip list " << writers << " writers > " << writers * ops / elapsed / 1e6 << " Mops/s, "
+              << walks << " range walks" << std::endl;
+}
+
+void test_skip_list_stress() {
+    std::cout << "skip list stress test" << std::endl;
+    run_skip_list_stress(1, 200000);
+    run_skip_list_stress(2, 100000);
+    run_skip_list_stress(4, 50000);
+    run_skip_list_stress(8, 25000);
+}
+
+void _main() {
+    std::cout << "skip list test" << std::endl;
+    test_skip_list_model(200000);
+    test_skip_list_strings();
+    test_skip_list_stress();
+}
@@ -0,0 +1,528 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "epoch.hpp"
+
+// per-thread free lists of blocks in Classes size classes, class c holding
+// blocks of BaseSize + c * Step bytes. a thread allocates and frees
+// through its own lists without synchronization; blocks are carved from
+// slabs that are never given back, so a block freed by any thread (e.g.
+// by epoch reclamation) can be reused by that thread. a thread hands its
+// lists to a shared pool when it exits
+template <size_t BaseSize, size_t Step, size_t Classes, size_t Align>
+class tower_pool {
+    struct free_block {
+        free_block *next;
+    };
+
+    static constexpr size_t slab_blocks = 64;
+
+    static constexpr size_t block_size(size_t c) {
+        return (BaseSize + c * Step + Align - 1) / Align * Align;
+    }
+
+    // trivially destructible, so it stays usable during thread exit
+    struct local_lists {
+        free_block *heads[Classes];
+        bool flushed;
+    };
+
+    struct shared_lists {
+        std::mutex mutex;
+        free_block *heads[Classes]{};
+        std::vector<void *> slabs;
+    };
+
+    // returns the thread's lists to the shared pool when the thread exits
+    struct flusher {
+        void touch() {}
+
+        ~flusher() {
+            auto& s = shared();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            for (size_t c = 0; c != Classes; ++c) {
+                while (free_block *block = local.heads[c]) {
+                    local.heads[c] = block->next;
+                    block->next = s.heads[c];
+                    s.heads[c] = block;
+                }
+            }
+            local.flushed = true;
+        }
+    };
+
+    static inline thread_local local_lists local{};
+    static inline thread_local flusher exit_flusher;
+
+    // never destroyed: blocks may still be freed by static destructors
+    static shared_lists& shared() {
+        static auto *lists = new shared_lists;
+        return *lists;
+    }
+
+    public:
+    static void* allocate(size_t c) {
+        assert(c < Classes);
+        exit_flusher.touch();
+
+        free_block *block = local.heads[c];
+        if (block == nullptr) {
+            block = refill(c);
+        }
+        local.heads[c] = block->next;
+        return block;
+    }
+
+    static void deallocate(void *ptr, size_t c) {
+        exit_flusher.touch();
+        auto *block = static_cast<free_block *>(ptr);
+        if (local.flushed) {
+            auto& s = shared();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            block->next = s.heads[c];
+            s.heads[c] = block;
+            return;
+        }
+        block->next = local.heads[c];
+        local.heads[c] = block;
+    }
+
+    private:
+    // takes the shared list of the class, or carves a new slab
+    static free_block* refill(size_t c) {
+        auto& s = shared();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.heads[c] != nullptr) {
+            free_block *list = s.heads[c];
+            s.heads[c] = nullptr;
+            return list;
+        }
+
+        char *slab = static_cast<char *>(::operator new(block_size(c) * slab_blocks, std::align_val_t(Align)));
+        s.slabs.push_back(slab);
+        free_block *list = nullptr;
+        for (size_t i = slab_blocks; i-- != 0; ) {
+            auto *block = reinterpret_cast<free_block *>(slab + i * block_size(c));
+            block->next = list;
+            list = block;
+        }
+        return list;
+    }
+};
+
+// lock-free ordered map (Fraser's skip list). every node has a tower of
+// 1..max_height next pointers, a level being present with probability 1/4
+// per step, so searches take O(log n) expected steps. the low bit of a
+// next pointer marks the node owning it as deleted at that level: erase
+// marks the tower top-down, and the thread whose mark lands on level 0
+// owns the erase. marked nodes are unlinked by whoever walks past them.
+// a node is retired to epoch reclamation once both its inserter and its
+// eraser are done with it, so it is unreachable from every level by then.
+// values are immutable after insert; find returns a copy. iteration is
+// weakly consistent: it sees every key present for the whole walk and
+// none that was absent for the whole walk
+template <typename K, typename V, typename Compare = std::less<K>>
+class skip_list_map {
+    public:
+    static constexpr uint32_t max_height = 16;
+
+    private:
+    struct node {
+        uint32_t height;
+        std::atomic<uint32_t> owners{2}; // inserter and eraser
+        alignas(K) unsigned char key_storage[sizeof(K)];
+        alignas(V) unsigned char value_storage[sizeof(V)];
+        std::atomic<uintptr_t> next[1]; // really `height` entries
+
+        const K& key() const {
+            return *reinterpret_cast<const K *>(key_storage);
+        }
+
+        const V& value() const {
+            return *reinterpret_cast<const V *>(value_storage);
+        }
+    };
+
+    using pool = tower_pool<sizeof(node), sizeof(std::atomic<uintptr_t>), max_height, alignof(node)>;
+
+    node *head;
+    std::atomic<size_t> length{0};
+    Compare less;
+
+    static node* ptr(uintptr_t link) {
+        return reinterpret_cast<node *>(link & ~uintptr_t(1));
+    }
+
+    static bool marked(uintptr_t link) {
+        return (link & 1) != 0;
+    }
+
+    static uintptr_t link(node *n, bool mark = false) {
+        return reinterpret_cast<uintptr_t>(n) | uintptr_t(mark);
+    }
+
+    public:
+    using key_type = K;
+    using mapped_type = V;
+
+    skip_list_map() {
+        head = create_node(max_height);
+    }
+
+    explicit skip_list_map(Compare less): skip_list_map() {
+        this->less = std::move(less);
+    }
+
+    skip_list_map(const skip_list_map&) = delete;
+    skip_list_map& operator = (const skip_list_map&) = delete;
+
+    // must not race with other operations
+    ~skip_list_map() {
+        node *n = ptr(head->next[0].load());
+        while (n != nullptr) {
+            node *next = ptr(n->next[0].load());
+            destroy_node(n);
+            n = next;
+        }
+        pool::deallocate(head, max_height - 1);
+    }
+
+    // approximate when called concurrently
+    size_t size() const {
+        return length.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // returns false and leaves the map untouched if the key is present
+    bool insert(const K& key, V value = V()) {
+        epoch_guard guard;
+        node *preds[max_height];
+        node *succs[max_height];
+
+        if (search(key, preds, succs)) {
+            return false;
+        }
+
+        uint32_t height = random_height();
+        node *n = create_node(height);
+        new (n->key_storage) K(key);
+        new (n->value_storage) V(std::move(value));
+
+        while (true) {
+            for (uint32_t l = 0; l != height; ++l) {
+                n->next[l].store(link(succs[l]), std::memory_order_relaxed);
+            }
+            uintptr_t expected = link(succs[0]);
+            if (preds[0]->next[0].compare_exchange_strong(expected, link(n), std::memory_order_release)) {
+                break;
+            }
+            if (search(key, preds, succs)) {
+                // never published, nobody else has seen it
+                destroy_node(n);
+                return false;
+            }
+        }
+        length.fetch_add(1, std::memory_order_relaxed);
+
+        // the node is in the set once it is on level 0, the upper levels
+        // are shortcuts linked bottom-up. an erase may start meanwhile:
+        // then stop linking and make sure the levels linked so far are gone
+        for (uint32_t l = 1; l != height; ++l) {
+            while (true) {
+                uintptr_t own = n->next[l].load(std::memory_order_acquire);
+                if (marked(own)) {
+                    unlink(n);
+                    release(n);
+                    return true;
+                }
+                if (ptr(own) != succs[l] && !n->next[l].compare_exchange_strong(own, link(succs[l]))) {
+                    continue;
+                }
+
+                uintptr_t expected = link(succs[l]);
+                if (preds[l]->next[l].compare_exchange_strong(expected, link(n), std::memory_order_release)) {
+                    break;
+                }
+                search(key, preds, succs);
+                if (succs[0] != n) {
+                    // erased and unlinked from level 0 already
+                    unlink(n);
+                    release(n);
+                    return true;
+                }
+            }
+        }
+
+        if (marked(n->next[height - 1].load(std::memory_order_acquire))) {
+            unlink(n);
+        }
+        release(n);
+        return true;
+    }
+
+    bool erase(const K& key) {
+        epoch_guard guard;
+        node *preds[max_height];
+        node *succs[max_height];
+
+        if (!search(key, preds, succs)) {
+            return false;
+        }
+
+        node *n = succs[0];
+        for (uint32_t l = n->height - 1; l != 0; --l) {
+            uintptr_t next = n->next[l].load(std::memory_order_acquire);
+            while (!marked(next) && !n->next[l].compare_exchange_weak(next, next | 1)) {
+            }
+        }
+
+        uintptr_t next = n->next[0].load(std::memory_order_acquire);
+        while (true) {
+            if (marked(next)) {
+                // another erase got there first
+                return false;
+            }
+            if (n->next[0].compare_exchange_weak(next, next | 1)) {
+                break;
+            }
+        }
+
+        length.fetch_sub(1, std::memory_order_relaxed);
+        unlink(n);
+        release(n);
+        return true;
+    }
+
+    bool contains(const K& key) const {
+        epoch_guard guard;
+        return find_node(key) != nullptr;
+    }
+
+    std::optional<V> find(const K& key) const {
+        epoch_guard guard;
+        node *n = find_node(key);
+        if (n == nullptr) {
+            return std::nullopt;
+        }
+        return n->value();
+    }
+
+    // calls func(key, value) in key order for every entry in [from, to),
+    // stops early when func returns false
+    template <typename Func>
+    void for_each(const K& from, const K& to, Func&& func) const {
+        epoch_guard guard;
+        node *n = lower_bound_node(from);
+        while (n != nullptr && less(n->key(), to)) {
+            uintptr_t next = n->next[0].load(std::memory_order_acquire);
+            if (!marked(next)) {
+                if constexpr (std::is_same_v<std::invoke_result_t<Func&, const K&, const V&>, bool>) {
+                    if (!func(n->key(), n->value())) {
+                        return;
+                    }
+                } else {
+                    func(n->key(), n->value());
+                }
+            }
+            n = ptr(next);
+        }
+    }
+
+    // every entry in key order
+    template <typename Func>
+    void for_each(Func&& func) const {
+        epoch_guard guard;
+        node *n = ptr(head->next[0].load(std::memory_order_acquire));
+        while (n != nullptr) {
+            uintptr_t next = n->next[0].load(std::memory_order_acquire);
+            if (!marked(next)) {
+                func(n->key(), n->value());
+            }
+            n = ptr(next);
+        }
+    }
+
+    private:
+    static node* create_node(uint32_t height) {
+        void *memory = pool::allocate(height - 1);
+        node *n = new (memory) node;
+        n->height = height;
+        n->next[0].store(0, std::memory_order_relaxed);
+        for (uint32_t l = 1; l < height; ++l) {
+            new (&n->next[l]) std::atomic<uintptr_t>(0);
+        }
+        return n;
+    }
+
+    static void destroy_node(node *n) {
+        reinterpret_cast<K *>(n->key_storage)->~K();
+        reinterpret_cast<V *>(n->value_storage)->~V();
+        uint32_t height = n->height;
+        n->~node();
+        pool::deallocate(n, height - 1);
+    }
+
+    // the last of inserter and eraser hands the node to epoch reclamation
+    static void release(node *n) {
+        if (n->owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            epoch_reclaimer::instance().retire(n, [](void *p) { destroy_node(static_cast<node *>(p)); });
+        }
+    }
+
+    static uint32_t random_height() {
+        thread_local uint64_t state = 0x9e3779b97f4a7c15ULL ^ reinterpret_cast<uintptr_t>(&state);
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        // two bits per level: each level is kept with probability 1/4
+        uint64_t bits = state | (uint64_t(1) << (2 * (max_height - 1)));
+        return 1 + uint32_t(__builtin_ctzll(bits) / 2);
+    }
+
+    // fills the last node before key and the first node not before it on
+    // every level, unlinking marked nodes on the way. true if the first
+    // node on level 0 has the key
+    bool search(const K& key, node **preds, node **succs) {
+        retry:
+        node *pred = head;
+        for (uint32_t l = max_height; l-- != 0; ) {
+            node *curr = ptr(pred->next[l].load(std::memory_order_acquire));
+            while (curr != nullptr) {
+                uintptr_t next = curr->next[l].load(std::memory_order_acquire);
+                if (marked(next)) {
+                    uintptr_t expected = link(curr);
+                    if (!pred->next[l].compare_exchange_strong(expected, link(ptr(next)), std::memory_order_acq_rel)) {
+                        goto retry;
+                    }
+                    curr = ptr(next);
+                } else if (less(curr->key(), key)) {
+                    pred = curr;
+                    curr = ptr(next);
+                } else {
+                    break;
+                }
+            }
+            preds[l] = pred;
+            succs[l] = curr;
+        }
+        return succs[0] != nullptr && !less(key, succs[0]->key());
+    }
+
+    // unlinks a marked node from every level. equal keys may sit on either
+    // side of it (a new insert of the same key), so they are walked past
+    // without becoming the start of the next level
+    void unlink(node *target) {
+        const K& key = target->key();
+
+        retry:
+        node *pred = head;
+        for (uint32_t l = max_height; l-- != 0; ) {
+            node *prev = pred;
+            node *curr = ptr(pred->next[l].load(std::memory_order_acquire));
+            while (curr != nullptr) {
+                uintptr_t next = curr->next[l].load(std::memory_order_acquire);
+                if (marked(next)) {
+                    uintptr_t expected = link(curr);
+                    if (!prev->next[l].compare_exchange_strong(expected, link(ptr(next)), std::memory_order_acq_rel)) {
+                        goto retry;
+                    }
+                    curr = ptr(next);
+                } else if (less(curr->key(), key)) {
+                    pred = prev = curr;
+                    curr = ptr(next);
+                } else if (!less(key, curr->key())) {
+                    prev = curr;
+                    curr = ptr(next);
+                } else {
+                    break;
+                }
+            }
+        }
+    }
+
+    // read-only search, marked nodes are skipped rather than unlinked
+    node* lower_bound_node(const K& key) const {
+        node *pred = head;
+        node *curr = nullptr;
+        for (uint32_t l = max_height; l-- != 0; ) {
+            curr = ptr(pred->next[l].load(std::memory_order_acquire));
+            while (curr != nullptr) {
+                uintptr_t next = curr->next[l].load(std::memory_order_acquire);
+                if (marked(next) || less(curr->key(), key)) {
+                    if (!marked(next)) {
+                        pred = curr;
+                    }
+                    curr = ptr(next);
+                } else {
+                    break;
+                }
+            }
+        }
+        return curr;
+    }
+
+    node* find_node(const K& key) const {
+        node *n = lower_bound_node(key);
+        return n != nullptr && !less(key, n->key()) ? n : nullptr;
+    }
+};
+
+struct skip_list_empty {};
+
+// ordered set on the same lock-free skip list
+template <typename K, typename Compare = std::less<K>>
+class skip_list_set {
+    skip_list_map<K, skip_list_empty, Compare> map;
+
+    public:
+    using key_type = K;
+    using value_type = K;
+
+    skip_list_set() {}
+
+    explicit skip_list_set(Compare less): map(std::move(less)) {}
+
+    size_t size() const {
+        return map.size();
+    }
+
+    bool empty() const {
+        return map.empty();
+    }
+
+    bool insert(const K& key) {
+        return map.insert(key);
+    }
+
+    bool erase(const K& key) {
+        return map.erase(key);
+    }
+
+    bool contains(const K& key) const {
+        return map.contains(key);
+    }
+
+    // calls func(key) in order for every key in [from, to)
+    template <typename Func>
+    void for_each(const K& from, const K& to, Func&& func) const {
+        map.for_each(from, to, [&func](const K& key, const skip_list_empty&) { return func(key); });
+    }
+
+    template <typename Func>
+    void for_each(Func&& func) const {
+        map.for_each([&func](const K& key, const skip_list_empty&) { func(key); });
+    }
+};
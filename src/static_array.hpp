@@ -0,0 +1,258 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+
+// fixed-capacity counterparts of ArrayStack and ArrayQueue. the slots are
+// a member array, so the containers never allocate, their footprint is
+// sizeof and nothing else, and every member is constexpr: a container can
+// be filled during constant evaluation and kept as a lookup table in a
+// constexpr variable. C++17 cannot construct objects in raw storage at
+// compile time, so all Capacity slots are value-initialized up front and
+// a slot that is removed from is reset to T(); T must be default
+// constructible. adding to a full container is an assertion failure, at
+// compile time a hard error
+
+template <typename T, uint32_t Capacity>
+class StaticArrayStack {
+    static_assert(Capacity != 0, "a static stack needs at least one slot");
+
+    T slots[Capacity]{};
+    uint32_t length{0};
+
+    public:
+    using value_type = T;
+
+    constexpr StaticArrayStack() {}
+
+    constexpr StaticArrayStack(std::initializer_list<T> values) {
+        assert(values.size() <= Capacity);
+        for (const T& value : values) {
+            slots[length++] = value;
+        }
+    }
+
+    constexpr uint32_t size() const {
+        return length;
+    }
+
+    static constexpr uint32_t capacity() {
+        return Capacity;
+    }
+
+    constexpr bool empty() const {
+        return length == 0;
+    }
+
+    constexpr bool full() const {
+        return length == Capacity;
+    }
+
+    constexpr T& get(size_t idx) {
+        assert(idx < length);
+        return slots[idx];
+    }
+
+    constexpr const T& get(size_t idx) const {
+        assert(idx < length);
+        return slots[idx];
+    }
+
+    constexpr T set(size_t idx, T val) {
+        T tmp = std::move(slots[idx]);
+        slots[idx] = std::move(val);
+        return tmp;
+    }
+
+    constexpr void add(size_t idx, T val) {
+        assert(length < Capacity && idx <= length);
+        for (size_t i = length; i > idx; --i) {
+            slots[i] = std::move(slots[i - 1]);
+        }
+        slots[idx] = std::move(val);
+        ++length;
+    }
+
+    constexpr T remove(size_t idx) {
+        assert(idx < length);
+        T tmp = std::move(slots[idx]);
+        for (size_t i = idx; i + 1 < length; ++i) {
+            slots[i] = std::move(slots[i + 1]);
+        }
+        slots[--length] = T();
+        return tmp;
+    }
+
+    constexpr void clear() {
+        while (length != 0) {
+            slots[--length] = T();
+        }
+    }
+
+    constexpr T* data() {
+        return slots;
+    }
+
+    constexpr const T* data() const {
+        return slots;
+    }
+
+    constexpr T* begin() {
+        return slots;
+    }
+
+    constexpr T* end() {
+        return slots + length;
+    }
+
+    constexpr const T* begin() const {
+        return slots;
+    }
+
+    constexpr const T* end() const {
+        return slots + length;
+    }
+};
+
+// ring buffer deque of at most Capacity elements, indices wrap with a mask
+// when Capacity is a power of two
+template <typename T, uint32_t Capacity>
+class StaticArrayQueue {
+    static_assert(Capacity != 0, "a static queue needs at least one slot");
+
+    T slots[Capacity]{};
+    uint32_t start_idx{0};
+    uint32_t length{0};
+
+    public:
+    using value_type = T;
+
+    constexpr StaticArrayQueue() {}
+
+    constexpr StaticArrayQueue(std::initializer_list<T> values) {
+        assert(values.size() <= Capacity);
+        for (const T& value : values) {
+            slots[length++] = value;
+        }
+    }
+
+    constexpr uint32_t size() const {
+        return length;
+    }
+
+    static constexpr uint32_t capacity() {
+        return Capacity;
+    }
+
+    constexpr bool empty() const {
+        return length == 0;
+    }
+
+    constexpr bool full() const {
+        return length == Capacity;
+    }
+
+    constexpr T& get(size_t idx) {
+        assert(idx < length);
+        return slots[wrap(start_idx + idx)];
+    }
+
+    constexpr const T& get(size_t idx) const {
+        assert(idx < length);
+        return slots[wrap(start_idx + idx)];
+    }
+
+    constexpr T set(size_t idx, T val) {
+        T tmp = std::move(get(idx));
+        get(idx) = std::move(val);
+        return tmp;
+    }
+
+    constexpr void add(T val) {
+        assert(length < Capacity);
+        slots[wrap(start_idx + length)] = std::move(val);
+        ++length;
+    }
+
+    // shifts whichever side of i is shorter
+    constexpr void add(size_t i, T val) {
+        assert(length < Capacity && i <= length);
+
+        if (i < length / 2) {
+            start_idx = wrap(start_idx + Capacity - 1);
+            for (size_t idx = 0; idx < i; ++idx) {
+                slots[wrap(start_idx + idx)] = std::move(slots[wrap(start_idx + idx + 1)]);
+            }
+        } else {
+            for (size_t idx = length; idx > i; --idx) {
+                slots[wrap(start_idx + idx)] = std::move(slots[wrap(start_idx + idx - 1)]);
+            }
+        }
+        slots[wrap(start_idx + i)] = std::move(val);
+        ++length;
+    }
+
+    constexpr void add_front(T val) {
+        assert(length < Capacity);
+        start_idx = wrap(start_idx + Capacity - 1);
+        slots[start_idx] = std::move(val);
+        ++length;
+    }
+
+    constexpr T remove() {
+        assert(length != 0);
+        T ret = std::move(slots[start_idx]);
+        slots[start_idx] = T();
+        start_idx = wrap(start_idx + 1);
+        --length;
+        return ret;
+    }
+
+    constexpr T remove_back() {
+        assert(length != 0);
+        --length;
+        T ret = std::move(slots[wrap(start_idx + length)]);
+        slots[wrap(start_idx + length)] = T();
+        return ret;
+    }
+
+    constexpr T remove(size_t i) {
+        assert(i < length);
+        T ret = std::move(slots[wrap(start_idx + i)]);
+
+        if (i < length / 2) {
+            for (size_t idx = i; idx > 0; --idx) {
+                slots[wrap(start_idx + idx)] = std::move(slots[wrap(start_idx + idx - 1)]);
+            }
+            slots[start_idx] = T();
+            start_idx = wrap(start_idx + 1);
+        } else {
+            for (size_t idx = i; idx + 1 < length; ++idx) {
+                slots[wrap(start_idx + idx)] = std::move(slots[wrap(start_idx + idx + 1)]);
+            }
+            slots[wrap(start_idx + length - 1)] = T();
+        }
+
+        --length;
+        return ret;
+    }
+
+    constexpr void clear() {
+        while (length != 0) {
+            remove_back();
+        }
+        start_idx = 0;
+    }
+
+    private:
+    static constexpr size_t wrap(size_t idx) {
+        if constexpr ((Capacity & (Capacity - 1)) == 0) {
+            return idx & (Capacity - 1);
+        } else {
+            return idx % Capacity;
+        }
+    }
+};
@@ -1,58 +1,39 @@
 #include <iostream>
-#include <memory>
-#include <queue>
-#include <stack>
-#include <unordered_set>
-
-template <typename T>
-struct tree_node {
-    T value{};
-    tree_node *left{nullptr};
-    tree_node *right{nullptr};
-
-    tree_node() {}
-
-    tree_node(T val): value(std::move(val)) {}
-
-    tree_node(T val, tree_node *left, tree_node *right): value(std::move(val)), left(left), right(right) {}
-};
-
-template <typename T>
-using visitor = std::function<void (tree_node<T> *)>;
-
-// (root, left, right)
-template <typename T>
-static void recursive_preorder(tree_node<T> *root, visitor<T> func) {
-    if (root != nullptr) {
-        func(root);
-        recursive_preorder(root->left, func);
-        recursive_preorder(root->right, func);
+#include <cassert>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "arena_tree.hpp"
+#include "linked_tree.hpp"
+#include "tree.hpp"
+
+// counts heap allocations so tests can check that iteration does none
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
     }
+    throw std::bad_alloc();
 }
 
-// (left, root, right)
-template <typename T>
-static void recursive_inorder(tree_node<T> *root, visitor<T> func) {
-    if (root != nullptr) {
-        recursive_inorder(root->left, func);
-        func(root);
-        recursive_inorder(root->right, func);
-    }
+void operator delete(void *p) noexcept {
+    std::free(p);
 }
 
-// (left, right, root)
-template <typename T>
-static void recursive_postorder(tree_node<T> *root, visitor<T> func) {
-    if (root != nullptr) {
-        recursive_postorder(root->left, func);
-        recursive_postorder(root->right, func);
-        func(root);
-    }
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
 }
 
 template <typename T>
 static void run_traverse(const char *name, 
-                                  std::function<void (tree_node<T>*, visitor<T>)> traverse,
+                                  std::function<bool (tree_node<T>*, visitor<T>)> traverse,
                                   visitor<T> visitor,
                                   tree_node<T> *root) {
     std::cout << "run " << name << std::endl;
@@ -60,156 +41,232 @@ static void run_traverse(const char *name,
     std:: cout << std::endl <<"====== end ======" << std::endl;
 }
 
-// (root, left, right)
-template <typename T>
-static void iterative_preorder(tree_node<T> *root, visitor<T> func) {
-    std::stack<tree_node<T> *> stack;
-
-    stack.push(root);
-
-    while (!stack.empty()) {
-        auto *node = stack.top();
-        stack.pop();
-
-        if (node != nullptr) {
-            func(node);
-            stack.push(node->right);
-            stack.push(node->left);
-        }
-    }
+static tree_node<int>* node(int val) {
+    return new tree_node<int>(val);
 }
 
-// (left, root, right)
-template <typename T>
-static void iterative_inorder_with_marking(tree_node<T> *root, visitor<T> func) {
-    std::stack<tree_node<T> *> stack;
-    std::unordered_set<tree_node<T> *> visited;
-    // auto *node = root;
-
-    stack.push(root);
-
-    while (!stack.empty()) {
-        auto *node = stack.top();
-
-        if (node == nullptr) {
-            // std::cout << "got nullptr" << endl;
-            stack.pop();
-            continue;
-        }
-        
-        if (node->left && visited.find(node->left) == visited.end()) {
-            stack.push(node->left);
-        } else {
-            stack.pop();
-            func(node);
-            visited.emplace(node);
-            stack.push(node->right);
-        }
-    }
+static tree_node<int>* node(int val, tree_node<int> *left, tree_node<int> *right) {
+    return new tree_node<int>(val, left, right);
 }
 
-// (left, root, right)
-template <typename T>
-static void iterative_inorder(tree_node<T> *root, visitor<T> func) {
-    std::stack<tree_node<T> *> stack;
-    auto *node = root;
-
-    stack.push(root);
-
-    while (!stack.empty()) {
-        if (!stack.top()) {
-            stack.pop();
-            continue;
-        }
-
-        if (node) {
-            // folow left child to the leaf
-            stack.push(node->left);
-            node = node->left;
-        } else {
-            node = stack.top();
-            stack.pop();
-            func(node);
-            stack.push(node->right);
-            node = node->right;
-        }        
-    }
+// every traversal visits nodes in its order and stops
+// right after the visitor returns false
+template <typename Traverse>
+static void test_traversal(const char *name, Traverse traverse, tree_node<int> *root, std::vector<int> expected) {
+    std::vector<int> order;
+    assert(traverse(root, [&order](tree_node<int> *node) { order.push_back(node->value); }));
+    assert(order == expected);
+
+    std::vector<int> prefix;
+    bool completed = traverse(root, [&prefix](tree_node<int> *node) {
+        prefix.push_back(node->value);
+        return prefix.size() < 3;
+    });
+    assert(!completed);
+    assert(prefix.size() == 3);
+    assert(std::equal(prefix.begin(), prefix.end(), expected.begin()));
+
+    // morris must leave no threaded links behind after a stop
+    order.clear();
+    traverse(root, [&order](tree_node<int> *node) { order.push_back(node->value); });
+    assert(order == expected);
+
+    std::cout << "test_traversal " << name << " > ok" << std::endl;
 }
 
-template <typename T>
-static void morris_inorder(tree_node<T> *root, visitor<T> func) {
-    tree_node<T> *curr = root;
-    tree_node<T> *prev = nullptr;
-
-    while (curr) {
-        if (curr->left == nullptr) {
-            func(curr);
-            curr = curr->right;
-        } else {
-            prev = curr->left;
-
-            while (prev->right != nullptr && prev->right != curr) {
-                prev = prev->right;
-            }
-
-            if (prev->right == nullptr) {
-                prev->right = curr;
-                curr = curr->left;
-            } else {
-                prev->right = nullptr;
-                func(curr);
-                curr = curr->right;
-            }
-        }
-    }
+static void test_traversals(tree_node<int> *root) {
+    std::vector<int> preorder{1, 2, 4, 5, 3, 6, 7};
+    std::vector<int> inorder{4, 2, 5, 1, 3, 7, 6};
+    std::vector<int> postorder{4, 5, 2, 7, 6, 3, 1};
+
+    test_traversal("recursive_preorder", [](auto *root, auto&& f) { return recursive_preorder(root, f); }, root, preorder);
+    test_traversal("recursive_inorder", [](auto *root, auto&& f) { return recursive_inorder(root, f); }, root, inorder);
+    test_traversal("recursive_postorder", [](auto *root, auto&& f) { return recursive_postorder(root, f); }, root, postorder);
+    test_traversal("iterative_preorder", [](auto *root, auto&& f) { return iterative_preorder(root, f); }, root, preorder);
+    test_traversal("iterative_inorder_with_marking", [](auto *root, auto&& f) { return iterative_inorder_with_marking(root, f); }, root, inorder);
+    test_traversal("iterative_inorder", [](auto *root, auto&& f) { return iterative_inorder(root, f); }, root, inorder);
+    test_traversal("morris_inorder", [](auto *root, auto&& f) { return morris_inorder(root, f); }, root, inorder);
+    test_traversal("iterative_postorder", [](auto *root, auto&& f) { return iterative_postorder(root, f); }, root, postorder);
 }
 
-// (left, right, root)
-template <typename T>
-static void iterative_postorder(tree_node<T> *root, visitor<T> func) {
-    std::stack<tree_node<T> *> stack;
+// every order forwards and backwards, without a single allocation
+template <typename Range>
+static void test_linked_order(const char *name, const Range& range, std::vector<int> expected) {
+    size_t before = allocations.load();
 
-    auto *node = root;
-    stack.push(root);
+    int seen[16];
+    size_t count = 0;
+    for (auto& v : range) {
+        assert(count < 16);
+        seen[count++] = v;
+    }
+    assert(std::equal(seen, seen + count, expected.begin(), expected.end()));
 
-    while (!stack.empty()) {
+    count = 0;
+    for (auto it = range.rbegin(); it != range.rend(); ++it) {
+        assert(count < 16);
+        seen[count++] = *it;
+    }
+    assert(std::equal(seen, seen + count, expected.rbegin(), expected.rend()));
+    assert(size_t(std::distance(range.begin(), range.end())) == expected.size());
 
-        if (node) {
-            tree_node<T> *follow = nullptr;
+    assert(allocations.load() == before);
+    std::cout << "test_linked_order " << name << " > ok" << std::endl;
+}
 
-            // follow left child to the leaf
-            if (node->left) {
-                stack.push(node->left);
-                follow = node->left;
-            } else if (node->right) {
-                // if no left child then follow right child
-                stack.push(node->right);
-                follow = node->right;
-            }
+static void test_linked_tree(tree_node<int> *root) {
+    linked_tree<int> tree(root);
+    test_linked_order("preorder", tree.preorder(), {1, 2, 4, 5, 3, 6, 7});
+    test_linked_order("inorder", tree.inorder(), {4, 2, 5, 1, 3, 7, 6});
+    test_linked_order("postorder", tree.postorder(), {4, 5, 2, 7, 6, 3, 1});
+
+    const linked_tree<int>& view = tree;
+    test_linked_order("const inorder", view, {4, 2, 5, 1, 3, 7, 6});
+
+    // views of inner subtrees stop at their root in both directions
+    using int_node = linked_tree_node<int>;
+    int_node *left = tree.get_root()->left;
+    int_node *right = tree.get_root()->right;
+    test_linked_order("left subtree preorder", linked_tree_range<int, tree_order::preorder, false>(left), {2, 4, 5});
+    test_linked_order("left subtree inorder", linked_tree_range<int, tree_order::inorder, false>(left), {4, 2, 5});
+    test_linked_order("left subtree postorder", linked_tree_range<int, tree_order::postorder, false>(left), {4, 5, 2});
+    test_linked_order("right subtree preorder", linked_tree_range<int, tree_order::preorder, false>(right), {3, 6, 7});
+    test_linked_order("right subtree inorder", linked_tree_range<int, tree_order::inorder, true>(right), {3, 7, 6});
+    test_linked_order("right subtree postorder", linked_tree_range<int, tree_order::postorder, false>(right), {7, 6, 3});
+    test_linked_order("leaf inorder", linked_tree_range<int, tree_order::inorder, false>(left->right), {5});
+
+    for (auto& v : tree) {
+        v *= 10;
+    }
+    assert(*tree.begin() == 40);
+    assert(*std::prev(tree.end()) == 60);
+
+    // single nodes and chains are the edge cases of the climbs
+    using node_type = linked_tree_node<int>;
+    linked_tree<int> left_chain(new node_type(3, new node_type(2, new node_type(1), nullptr), nullptr));
+    test_linked_order("left chain preorder", left_chain.preorder(), {3, 2, 1});
+    test_linked_order("left chain inorder", left_chain.inorder(), {1, 2, 3});
+    test_linked_order("left chain postorder", left_chain.postorder(), {1, 2, 3});
+
+    linked_tree<int> right_chain(new node_type(1, nullptr, new node_type(2, nullptr, new node_type(3))));
+    test_linked_order("right chain preorder", right_chain.preorder(), {1, 2, 3});
+    test_linked_order("right chain postorder", right_chain.postorder(), {3, 2, 1});
+
+    linked_tree<int> empty;
+    assert(empty.begin() == empty.end());
+    assert(empty.postorder().begin() == empty.postorder().end());
+}
 
-            node = follow;
-        } else {
-            auto *top = stack.top();
-            stack.pop();
+static tree_node<int>* build_tree(int lo, int hi) {
+    if (lo >= hi) {
+        return nullptr;
+    }
 
-            func(top);
+    int mid = lo + (hi - lo) / 2;
+    return new tree_node<int>(mid, build_tree(lo, mid), build_tree(mid + 1, hi));
+}
 
-            if (!stack.empty() && (stack.top()->left == top)) {
-                if (stack.top()->right) {
-                    stack.push(stack.top()->right);
-                    node = stack.top();
+// readers share the tree with no synchronization since nothing is written
+static void test_linked_tree_readers() {
+    auto *root = build_tree(0, 100000);
+    const linked_tree<int> tree(root);
+    recursive_postorder(root, [](tree_node<int> *node) { delete node; });
+
+    std::vector<std::thread> readers;
+    std::atomic<size_t> failures{0};
+    for (size_t t = 0; t != 4; ++t) {
+        readers.emplace_back([&tree, &failures] {
+            for (size_t round = 0; round != 10; ++round) {
+                int expected = 0;
+                for (const int& v : tree) {
+                    failures += v != expected++;
+                }
+                for (const int& v : tree.postorder()) {
+                    expected -= v >= 0;
                 }
+                failures += expected != 0;
             }
-        }        
+        });
     }
+    for (auto& t : readers) {
+        t.join();
+    }
+    assert(failures == 0);
+
+    std::cout << "test_linked_tree_readers > ok" << std::endl;
 }
 
-static tree_node<int>* node(int val) {
-    return new tree_node<int>(val);
+// the same orders and early stops as the pointer tree, over indices
+static void test_arena_tree(tree_node<int> *root) {
+    static_assert(sizeof(arena_node<int>) == 12);
+
+    arena_tree<int> tree(root);
+    assert(tree.size() == 7);
+    assert(tree[tree.get_root()].value == 1);
+
+    auto check = [&tree](const char *name, auto traverse, std::vector<int> expected) {
+        std::vector<int> order;
+        assert(traverse(tree, [&order](arena_node<int>& node) { order.push_back(node.value); }));
+        assert(order == expected);
+
+        std::vector<int> prefix;
+        assert(!traverse(tree, [&prefix](const arena_node<int>& node) {
+            prefix.push_back(node.value);
+            return prefix.size() < 3;
+        }));
+        assert(std::equal(prefix.begin(), prefix.end(), expected.begin()));
+
+        // morris must leave no threaded links behind after a stop
+        order.clear();
+        traverse(tree, [&order](arena_node<int>& node) { order.push_back(node.value); });
+        assert(order == expected);
+
+        std::cout << "test_arena_tree " << name << " > ok" << std::endl;
+    };
+
+    std::vector<int> preorder{1, 2, 4, 5, 3, 6, 7};
+    std::vector<int> inorder{4, 2, 5, 1, 3, 7, 6};
+    std::vector<int> postorder{4, 5, 2, 7, 6, 3, 1};
+    check("recursive_preorder", [](auto& t, auto&& f) { return recursive_preorder(t, f); }, preorder);
+    check("recursive_inorder", [](auto& t, auto&& f) { return recursive_inorder(t, f); }, inorder);
+    check("recursive_postorder", [](auto& t, auto&& f) { return recursive_postorder(t, f); }, postorder);
+    check("iterative_preorder", [](auto& t, auto&& f) { return iterative_preorder(t, f); }, preorder);
+    check("iterative_inorder_with_marking", [](auto& t, auto&& f) { return iterative_inorder_with_marking(t, f); }, inorder);
+    check("iterative_inorder", [](auto& t, auto&& f) { return iterative_inorder(t, f); }, inorder);
+    check("morris_inorder", [](auto& t, auto&& f) { return morris_inorder(t, f); }, inorder);
+    check("iterative_postorder", [](auto& t, auto&& f) { return iterative_postorder(t, f); }, postorder);
+
+    // a clone is an independent copy of the buffer
+    auto copy = tree.clone();
+    copy.for_each([](arena_node<int>& node) { node.value *= 10; });
+    std::vector<int> order;
+    recursive_inorder(copy, [&order](const arena_node<int>& node) { order.push_back(node.value / 10); });
+    assert(order == inorder);
+    order.clear();
+    const auto& view = tree;
+    iterative_inorder(view, [&order](const arena_node<int>& node) { order.push_back(node.value); });
+    assert(order == inorder);
 }
 
-static tree_node<int>* node(int val, tree_node<int> *left, tree_node<int> *right) {
-    return new tree_node<int>(val, left, right);
+// a million deep chain is built, walked and dropped without recursion
+static void test_arena_tree_degenerate() {
+    arena_tree<std::string> tree;
+    uint32_t below = arena_tree<std::string>::null;
+    for (size_t i = 0; i != 1000000; ++i) {
+        below = tree.add(std::to_string(i), below);
+    }
+    tree.set_root(below);
+
+    size_t count = 0;
+    iterative_postorder(tree, [&count](auto& node) { assert(node.value == std::to_string(count++)); });
+    assert(count == tree.size());
+    assert(iterative_preorder(tree, [](auto& node) { return node.value != "999999"; }) == false);
+
+    auto copy = tree.clone();
+    tree.clear();
+    assert(tree.empty() && copy.size() == 1000000);
+
+    std::cout << "test_arena_tree_degenerate > ok" << std::endl;
 }
 
 void _main() {
@@ -224,15 +281,21 @@ void _main() {
                                 nullptr)));
 
     auto printer = [] (auto *node) { std::cout << node->value << " "; };
-    run_traverse<int>("r preorder (root, left, right)", recursive_preorder<int>, printer, root);
-    run_traverse<int>("r inorder (left, root, right)", recursive_inorder<int>, printer, root);
-    run_traverse<int>("r postorder (left, right, root)", recursive_postorder<int>, printer, root);
-    
-    run_traverse<int>("i preorder (root, left, right)", iterative_preorder<int>, printer, root);
-    run_traverse<int>("i inorder marking (left, root, right)", iterative_inorder_with_marking<int>, printer, root);
-    run_traverse<int>("i inorder (left, root, right)", iterative_inorder<int>, printer, root);
-    run_traverse<int>("i morris inorder (left, root, right)", morris_inorder<int>, printer, root);
-    run_traverse<int>("i postorder (left, right, root)", iterative_postorder<int>, printer, root);
+    run_traverse<int>("r preorder (root, left, right)", recursive_preorder<int, visitor<int>>, printer, root);
+    run_traverse<int>("r inorder (left, root, right)", recursive_inorder<int, visitor<int>>, printer, root);
+    run_traverse<int>("r postorder (left, right, root)", recursive_postorder<int, visitor<int>>, printer, root);
     
-    recursive_postorder<int>(root, [](auto *node) { delete node; });
+    run_traverse<int>("i preorder (root, left, right)", iterative_preorder<int, visitor<int>>, printer, root);
+    run_traverse<int>("i inorder marking (left, root, right)", iterative_inorder_with_marking<int, visitor<int>>, printer, root);
+    run_traverse<int>("i inorder (left, root, right)", iterative_inorder<int, visitor<int>>, printer, root);
+    run_traverse<int>("i morris inorder (left, root, right)", morris_inorder<int, visitor<int>>, printer, root);
+    run_traverse<int>("i postorder (left, right, root)", iterative_postorder<int, visitor<int>>, printer, root);
+
+    test_traversals(root);
+    test_linked_tree(root);
+    test_linked_tree_readers();
+    test_arena_tree(root);
+    test_arena_tree_degenerate();
+
+    recursive_postorder(root, [](auto *node) { delete node; });
 }
\ No newline at end of file
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <functional>
+#include <stack>
+#include <type_traits>
+#include "hash.hpp"
+
+template <typename T>
+struct tree_node {
+    T value{};
+    tree_node *left{nullptr};
+    tree_node *right{nullptr};
+
+    tree_node() {}
+
+    tree_node(T val): value(std::move(val)) {}
+
+    tree_node(T val, tree_node *left, tree_node *right): value(std::move(val)), left(left), right(right) {}
+};
+
+// opt-in type-erased visitor, traversals accept any callable taking a node.
+// a callable returning bool stops the traversal as soon as it returns false
+template <typename T>
+using visitor = std::function<void (tree_node<T> *)>;
+
+template <typename T, typename Visitor>
+inline bool visit(Visitor& func, tree_node<T> *node) {
+    if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, tree_node<T> *>, bool>) {
+        return func(node);
+    } else {
+        func(node);
+        return true;
+    }
+}
+
+// traversals return false when the visitor stopped them early
+
+// (root, left, right)
+template <typename T, typename Visitor>
+static bool recursive_preorder(tree_node<T> *root, Visitor&& func) {
+    if (root != nullptr) {
+        return visit(func, root)
+            && recursive_preorder(root->left, func)
+            && recursive_preorder(root->right, func);
+    }
+    return true;
+}
+
+// (left, root, right)
+template <typename T, typename Visitor>
+static bool recursive_inorder(tree_node<T> *root, Visitor&& func) {
+    if (root != nullptr) {
+        return recursive_inorder(root->left, func)
+            && visit(func, root)
+            && recursive_inorder(root->right, func);
+    }
+    return true;
+}
+
+// (left, right, root)
+template <typename T, typename Visitor>
+static bool recursive_postorder(tree_node<T> *root, Visitor&& func) {
+    if (root != nullptr) {
+        return recursive_postorder(root->left, func)
+            && recursive_postorder(root->right, func)
+            && visit(func, root);
+    }
+    return true;
+}
+
+// (root, left, right)
+template <typename T, typename Visitor>
+static bool iterative_preorder(tree_node<T> *root, Visitor&& func) {
+    std::stack<tree_node<T> *> stack;
+
+    stack.push(root);
+
+    while (!stack.empty()) {
+        auto *node = stack.top();
+        stack.pop();
+
+        if (node != nullptr) {
+            if (!visit(func, node)) {
+                return false;
+            }
+            stack.push(node->right);
+            stack.push(node->left);
+        }
+    }
+    return true;
+}
+
+// (left, root, right)
+template <typename T, typename Visitor>
+static bool iterative_inorder_with_marking(tree_node<T> *root, Visitor&& func) {
+    std::stack<tree_node<T> *> stack;
+    flat_hash_set<tree_node<T> *> visited;
+    // auto *node = root;
+
+    stack.push(root);
+
+    while (!stack.empty()) {
+        auto *node = stack.top();
+
+        if (node == nullptr) {
+            // std::cout << "got nullptr" << endl;
+            stack.pop();
+            continue;
+        }
+        
+        if (node->left && !visited.contains(node->left)) {
+            stack.push(node->left);
+        } else {
+            stack.pop();
+            if (!visit(func, node)) {
+                return false;
+            }
+            visited.insert(node);
+            stack.push(node->right);
+        }
+    }
+    return true;
+}
+
+// (left, root, right)
+template <typename T, typename Visitor>
+static bool iterative_inorder(tree_node<T> *root, Visitor&& func) {
+    std::stack<tree_node<T> *> stack;
+    auto *node = root;
+
+    stack.push(root);
+
+    while (!stack.empty()) {
+        if (!stack.top()) {
+            stack.pop();
+            continue;
+        }
+
+        if (node) {
+            // folow left child to the leaf
+            stack.push(node->left);
+            node = node->left;
+        } else {
+            node = stack.top();
+            stack.pop();
+            if (!visit(func, node)) {
+                return false;
+            }
+            stack.push(node->right);
+            node = node->right;
+        }        
+    }
+    return true;
+}
+
+template <typename T, typename Visitor>
+static bool morris_inorder(tree_node<T> *root, Visitor&& func) {
+    tree_node<T> *curr = root;
+    tree_node<T> *prev = nullptr;
+    // after an early stop the walk goes on without visiting,
+    // it is the only way to undo the temporary right links
+    bool visiting = true;
+
+    while (curr) {
+        if (curr->left == nullptr) {
+            visiting = visiting && visit(func, curr);
+            curr = curr->right;
+        } else {
+            prev = curr->left;
+
+            while (prev->right != nullptr && prev->right != curr) {
+                prev = prev->right;
+            }
+
+            if (prev->right == nullptr) {
+                prev->right = curr;
+                curr = curr->left;
+            } else {
+                prev->right = nullptr;
+                visiting = visiting && visit(func, curr);
+                curr = curr->right;
+            }
+        }
+    }
+    return visiting;
+}
+
+// (left, right, root)
+template <typename T, typename Visitor>
+static bool iterative_postorder(tree_node<T> *root, Visitor&& func) {
+    std::stack<tree_node<T> *> stack;
+
+    auto *node = root;
+    stack.push(root);
+
+    while (!stack.empty()) {
+
+        if (node) {
+            tree_node<T> *follow = nullptr;
+
+            // follow left child to the leaf
+            if (node->left) {
+                stack.push(node->left);
+                follow = node->left;
+            } else if (node->right) {
+                // if no left child then follow right child
+                stack.push(node->right);
+                follow = node->right;
+            }
+
+            node = follow;
+        } else {
+            auto *top = stack.top();
+            stack.pop();
+
+            if (!visit(func, top)) {
+                return false;
+            }
+
+            if (!stack.empty() && (stack.top()->left == top)) {
+                if (stack.top()->right) {
+                    stack.push(stack.top()->right);
+                    node = stack.top();
+                }
+            }
+        }        
+    }
+    return true;
+}